@@ -0,0 +1,339 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+/* Microbenchmarks for the game engine. Each benchmark is run with an
+ * increasing number of iterations until it has used at least the minimum
+ * amount of time, and the time and number of arena allocations per
+ * iteration are printed as CSV or JSON. All boards are made from fixed seeds,
+ * so runs are comparable between commits. */
+
+#include "game.h"
+#include "card.h"
+#include "rc.h"
+#include "rng.h"
+#include "arena.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+/* Number of representative boards per game */
+#define BOARD_COUNT 16
+
+/* Number of random moves played on each board after the deal */
+#define BOARD_MOVES 40
+
+typedef struct fixture Fixture;
+typedef struct candidate Candidate;
+
+/* A possible stack move on one of the boards */
+struct candidate {
+  GameState *state;
+  Pile *dest;
+  Card *src;
+  Pile *src_pile;
+};
+
+/* The data that the benchmarks of a single game work on. The boards and their
+ * undo histories are allocated from `arena`, everything else that the
+ * benchmarks allocate comes from `scratch`. */
+struct fixture {
+  Game *game;
+  Arena *arena;
+  Arena *scratch;
+  Card *deck;
+  GameState *boards[BOARD_COUNT];
+  Candidate *accepted;
+  int accepted_count;
+  Candidate *rejected;
+  int rejected_count;
+};
+
+typedef void (*BenchFunction)(Fixture *fixture, long iterations);
+
+static double min_time = 0.2;
+static int json = 0;
+static int results = 0;
+
+static Card *new_shuffled_deck(Arena *arena, Game *game, uint32_t seed) {
+  Card *deck = new_deck(arena, game->decks, game->deck_suits);
+  Rng rng;
+  rng_seed(&rng, seed);
+  shuffle_stack(next_card(deck), &rng);
+  return deck;
+}
+
+static void add_candidates(Fixture *fixture, GameState *state, int *capacity) {
+  Pile *src_pile, *dest;
+  for (src_pile = state->piles; src_pile; src_pile = src_pile->next) {
+    Stack *stack = src_pile->stack->stack;
+    int i;
+    for (i = 1; i < stack->size; i++) {
+      if (!stack->cards[i]->up) {
+        continue;
+      }
+      for (dest = state->piles; dest; dest = dest->next) {
+        Candidate *candidate;
+        if (dest == src_pile) {
+          continue;
+        }
+        if (fixture->accepted_count >= *capacity || fixture->rejected_count >= *capacity) {
+          *capacity *= 2;
+          fixture->accepted = realloc(fixture->accepted, *capacity * sizeof(Candidate));
+          fixture->rejected = realloc(fixture->rejected, *capacity * sizeof(Candidate));
+        }
+        if (can_move_stack(dest, stack->cards[i], src_pile, state->piles)) {
+          candidate = &fixture->accepted[fixture->accepted_count++];
+        } else {
+          candidate = &fixture->rejected[fixture->rejected_count++];
+        }
+        candidate->state = state;
+        candidate->dest = dest;
+        candidate->src = stack->cards[i];
+        candidate->src_pile = src_pile;
+      }
+    }
+  }
+}
+
+/* Deals the boards of a game and plays random moves on them */
+static Fixture *new_fixture(Game *game) {
+  Fixture *fixture = malloc(sizeof(Fixture));
+  MoveList *list = new_move_list();
+  int capacity = 256;
+  int i, j;
+  fixture->game = game;
+  fixture->arena = new_arena(DEAL_ARENA_SIZE);
+  fixture->scratch = new_arena(DEAL_ARENA_SIZE);
+  fixture->deck = new_shuffled_deck(fixture->arena, game, 1);
+  fixture->accepted = malloc(capacity * sizeof(Candidate));
+  fixture->accepted_count = 0;
+  fixture->rejected = malloc(capacity * sizeof(Candidate));
+  fixture->rejected_count = 0;
+  for (i = 0; i < BOARD_COUNT; i++) {
+    Card *deck = new_shuffled_deck(fixture->arena, game, i + 1);
+    GameState *state = new_game_state(fixture->arena, game, deck);
+    Rng rng;
+    rng_seed(&rng, i + 1);
+    for (j = 0; j < BOARD_MOVES; j++) {
+      int count = generate_moves(state->piles, list);
+      if (!count) {
+        break;
+      }
+      play_move(state, list->moves[rng_range(&rng, count)]);
+    }
+    fixture->boards[i] = state;
+    add_candidates(fixture, state, &capacity);
+  }
+  delete_move_list(list);
+  return fixture;
+}
+
+static void delete_fixture(Fixture *fixture) {
+  delete_arena(fixture->arena);
+  delete_arena(fixture->scratch);
+  free(fixture->accepted);
+  free(fixture->rejected);
+  free(fixture);
+}
+
+static void bench_new_deck(Fixture *fixture, long iterations) {
+  long i;
+  for (i = 0; i < iterations; i++) {
+    new_deck(fixture->scratch, fixture->game->decks, fixture->game->deck_suits);
+    clear_arena(fixture->scratch);
+  }
+}
+
+static void bench_shuffle_stack(Fixture *fixture, long iterations) {
+  Card *deck = new_deck(fixture->scratch, fixture->game->decks, fixture->game->deck_suits);
+  Rng rng;
+  long i;
+  rng_seed(&rng, 1);
+  for (i = 0; i < iterations; i++) {
+    shuffle_stack(next_card(deck), &rng);
+  }
+  clear_arena(fixture->scratch);
+}
+
+static void bench_deal(Fixture *fixture, long iterations) {
+  long i;
+  for (i = 0; i < iterations; i++) {
+    new_game_state(fixture->scratch, fixture->game, fixture->deck);
+    clear_arena(fixture->scratch);
+  }
+}
+
+/* The move is undone afterwards to restore the board */
+static void bench_legal_move_stack_accept(Fixture *fixture, long iterations) {
+  long i;
+  for (i = 0; i < iterations; i++) {
+    Candidate *candidate = &fixture->accepted[i % fixture->accepted_count];
+    int32_t score = candidate->state->score;
+    legal_move_stack(candidate->state, candidate->dest, candidate->src, candidate->src_pile);
+    undo_move(candidate->state);
+    candidate->state->score = score;
+  }
+}
+
+static void bench_legal_move_stack_reject(Fixture *fixture, long iterations) {
+  long i;
+  for (i = 0; i < iterations; i++) {
+    Candidate *candidate = &fixture->rejected[i % fixture->rejected_count];
+    legal_move_stack(candidate->state, candidate->dest, candidate->src, candidate->src_pile);
+  }
+}
+
+/* A move made by auto_move_to_foundation is undone afterwards */
+static void bench_auto_move_to_foundation(Fixture *fixture, long iterations) {
+  long i;
+  for (i = 0; i < iterations; i++) {
+    GameState *state = fixture->boards[i % BOARD_COUNT];
+    int32_t score = state->score;
+    if (auto_move_to_foundation(state)) {
+      undo_move(state);
+      state->score = score;
+    }
+  }
+}
+
+static void bench_check_win_condition(Fixture *fixture, long iterations) {
+  long i;
+  for (i = 0; i < iterations; i++) {
+    check_win_condition(fixture->boards[i % BOARD_COUNT]->piles);
+  }
+}
+
+static void bench_undo_redo(Fixture *fixture, long iterations) {
+  long i;
+  for (i = 0; i < iterations; i++) {
+    GameState *state = fixture->boards[i % BOARD_COUNT];
+    if (undo_move(state)) {
+      redo_move(state);
+    }
+  }
+}
+
+static void get_allocations(Fixture *fixture, ArenaStats *stats) {
+  ArenaStats scratch;
+  get_arena_stats(fixture->arena, stats);
+  get_arena_stats(fixture->scratch, &scratch);
+  stats->allocations += scratch.allocations;
+  stats->blocks += scratch.blocks;
+}
+
+static void print_result(const char *name, Game *game, long iterations, double ns, double allocations,
+    double mallocs) {
+  if (json) {
+    printf("%s\n  {\"benchmark\": \"%s\", \"game\": \"%s\", \"iterations\": %ld, \"ns_per_op\": %.2f, "
+        "\"allocs_per_op\": %.4f, \"mallocs_per_op\": %.4f}", results ? "," : "[",
+        name, game->name, iterations, ns, allocations, mallocs);
+  } else {
+    if (!results) {
+      printf("benchmark,game,iterations,ns_per_op,allocs_per_op,mallocs_per_op\n");
+    }
+    printf("%s,%s,%ld,%.2f,%.4f,%.4f\n", name, game->name, iterations, ns, allocations, mallocs);
+  }
+  results++;
+}
+
+/* Runs a benchmark with an increasing number of iterations until it takes at
+ * least `min_time` seconds */
+static void run_benchmark(const char *name, Fixture *fixture, BenchFunction function) {
+  ArenaStats before, after;
+  long iterations = 1;
+  double elapsed;
+  while (1) {
+    unsigned long start;
+    double factor;
+    get_allocations(fixture, &before);
+    start = get_milliseconds();
+    function(fixture, iterations);
+    elapsed = (get_milliseconds() - start) / 1000.0;
+    get_allocations(fixture, &after);
+    if (elapsed >= min_time || iterations > LONG_MAX / 100) {
+      break;
+    }
+    factor = elapsed > 0 ? 1.2 * min_time / elapsed : 100;
+    if (factor > 100) {
+      factor = 100;
+    } else if (factor < 2) {
+      factor = 2;
+    }
+    iterations = (long)(iterations * factor);
+  }
+  print_result(name, fixture->game, iterations, elapsed * 1e9 / iterations,
+      (double)(after.allocations - before.allocations) / iterations,
+      (double)(after.blocks - before.blocks) / iterations);
+}
+
+static void bench_game(Game *game) {
+  Fixture *fixture = new_fixture(game);
+  run_benchmark("new_deck", fixture, bench_new_deck);
+  run_benchmark("shuffle_stack", fixture, bench_shuffle_stack);
+  run_benchmark("deal", fixture, bench_deal);
+  if (fixture->accepted_count) {
+    run_benchmark("legal_move_stack_accept", fixture, bench_legal_move_stack_accept);
+  }
+  if (fixture->rejected_count) {
+    run_benchmark("legal_move_stack_reject", fixture, bench_legal_move_stack_reject);
+  }
+  run_benchmark("auto_move_to_foundation", fixture, bench_auto_move_to_foundation);
+  run_benchmark("check_win_condition", fixture, bench_check_win_condition);
+  run_benchmark("undo_redo", fixture, bench_undo_redo);
+  delete_fixture(fixture);
+}
+
+static void describe_usage(const char *program) {
+  printf("usage: %s [-j] [-t seconds] [-c file] [game...]\n", program);
+  puts("  -j          print the results as JSON instead of CSV");
+  puts("  -t seconds  minimum time for each benchmark (default 0.2)");
+  puts("  -c file     configuration file that defines the games (default csolrc)");
+}
+
+int main(int argc, char *argv[]) {
+  char *rc_file = "csolrc";
+  int i, first_game = argc;
+  for (i = 1; i < argc && first_game == argc; i++) {
+    if (strcmp(argv[i], "-j") == 0) {
+      json = 1;
+    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      min_time = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      rc_file = argv[++i];
+    } else if (argv[i][0] == '-') {
+      describe_usage(argv[0]);
+      return 1;
+    } else {
+      first_game = i;
+    }
+  }
+  if (!execute_file(rc_file)) {
+    return 1;
+  }
+  if (first_game < argc) {
+    for (i = first_game; i < argc; i++) {
+      Game *game = get_game(argv[i]);
+      if (!game) {
+        printf("game not found: '%s'\n", argv[i]);
+        return 1;
+      }
+      bench_game(game);
+    }
+  } else {
+    GameList *list;
+    load_game_dirs();
+    for (list = list_games(); list; list = list->next) {
+      bench_game(list->game);
+    }
+  }
+  if (json) {
+    printf("%s\n", results ? "\n]" : "[]");
+  }
+  return 0;
+}
@@ -0,0 +1,235 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+/* Rendering benchmark. Every game is drawn with every theme on a screen that
+ * only exists in memory: a random game is played and undone and redone move
+ * by move, and the board is redrawn after each move the same way the user
+ * interface does it. The frame rate and the number of bytes a terminal would
+ * receive per frame are printed as CSV or JSON. */
+
+#include "game.h"
+#include "card.h"
+#include "theme.h"
+#include "menu.h"
+#include "rc.h"
+#include "rng.h"
+#include "arena.h"
+#include "color.h"
+#include "screen.h"
+#include "render.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Maximum number of random moves played on the board */
+#define BOARD_MOVES 200
+
+/* The top level of the menubar of the user interface */
+static Menu menubar[] = {
+  {"&File", NULL, 0, NULL, NULL},
+  {"&Move", NULL, 0, NULL, NULL},
+  {"&Game", NULL, 0, NULL, NULL},
+  {"&Theme", NULL, 0, NULL, NULL},
+  {"&Settings", NULL, 0, NULL, NULL},
+  {"&Help", NULL, 0, NULL, NULL},
+  {NULL, NULL, 0, NULL, NULL}
+};
+
+static double min_time = 0.2;
+static int json = 0;
+static int results = 0;
+static int screen_width = 80;
+static int screen_height = 24;
+
+/* Draws a frame like ui_loop. Returns the number of bytes sent to the
+ * terminal. */
+static long draw_frame(Screen *screen, GameState *state, Theme *theme, int *bottoms, int all,
+    int *score_width) {
+  draw_piles(screen, state, theme, 0, NULL, bottoms, all);
+  if (show_score) {
+    draw_score(screen, state->score, score_width);
+  }
+  if (show_menu) {
+    Menu *item;
+    int x;
+    screen->pair = COLOR_PAIR_BACKGROUND;
+    screen->attr = 0;
+    x = screen_print(screen, 0, 0, " ");
+    for (item = menubar; item->label; item++) {
+      x = screen_print(screen, 0, x, " ");
+      x = draw_menu_label(screen, 0, x, item->label, 1);
+      x = screen_print(screen, 0, x, " ");
+    }
+  }
+  return flush_memory_screen(screen);
+}
+
+/* Deals a board and plays random moves on it, then undoes them again */
+static GameState *new_board(Arena *arena, Game *game, int *moves) {
+  Card *deck = new_deck(arena, game->decks, game->deck_suits);
+  MoveList *list = new_move_list();
+  GameState *state;
+  Rng rng;
+  rng_seed(&rng, 1);
+  shuffle_stack(next_card(deck), &rng);
+  state = new_game_state(arena, game, deck);
+  for (*moves = 0; *moves < BOARD_MOVES; (*moves)++) {
+    int count = generate_moves(state->piles, list);
+    if (!count || !play_move(state, list->moves[rng_range(&rng, count)])) {
+      break;
+    }
+  }
+  while (undo_move(state)) {
+  }
+  delete_move_list(list);
+  return state;
+}
+
+static void print_result(Theme *theme, Game *game, long frames, double fps, double bytes,
+    double full_fps, long full_bytes) {
+  if (json) {
+    printf("%s\n  {\"theme\": \"%s\", \"game\": \"%s\", \"frames\": %ld, \"frames_per_sec\": %.1f, "
+        "\"bytes_per_frame\": %.1f, \"full_frames_per_sec\": %.1f, \"bytes_per_full_frame\": %ld}",
+        results ? "," : "[", theme->name, game->name, frames, fps, bytes, full_fps, full_bytes);
+  } else {
+    if (!results) {
+      printf("theme,game,frames,frames_per_sec,bytes_per_frame,full_frames_per_sec,bytes_per_full_frame\n");
+    }
+    printf("%s,%s,%ld,%.1f,%.1f,%.1f,%ld\n", theme->name, game->name, frames, fps, bytes, full_fps,
+        full_bytes);
+  }
+  results++;
+}
+
+/* Measures full redraws of the dealt board, and redraws after each move while
+ * the moves are undone and redone until `min_time` has passed */
+static void bench_render(Theme *theme, Game *game) {
+  Arena *arena = new_arena(DEAL_ARENA_SIZE);
+  Screen *screen = new_memory_screen(screen_width, screen_height, 1);
+  GameState *state;
+  int *bottoms;
+  int moves, score_width = 0, undo = 0, i;
+  long frames = 0, full_frames = 0, full_bytes, bytes = 0;
+  double elapsed = 0, full_elapsed = 0;
+  unsigned long start;
+  state = new_board(arena, game, &moves);
+  bottoms = arena_alloc(arena, state->pile_count * sizeof(int));
+  full_bytes = draw_frame(screen, state, theme, bottoms, 1, &score_width);
+  start = get_milliseconds();
+  do {
+    for (i = 0; i < 100; i++) {
+      draw_frame(screen, state, theme, bottoms, 1, &score_width);
+      full_frames++;
+    }
+    full_elapsed = (get_milliseconds() - start) / 1000.0;
+  } while (full_elapsed < min_time);
+  start = get_milliseconds();
+  while (moves > 0 && elapsed < min_time) {
+    for (i = 0; i < moves; i++) {
+      if (undo) {
+        undo_move(state);
+      } else {
+        redo_move(state);
+      }
+      bytes += draw_frame(screen, state, theme, bottoms, 0, &score_width);
+      frames++;
+    }
+    undo = !undo;
+    elapsed = (get_milliseconds() - start) / 1000.0;
+  }
+  print_result(theme, game, frames, elapsed > 0 ? frames / elapsed : 0, frames ? (double)bytes / frames : 0,
+      full_frames / full_elapsed, full_bytes);
+  delete_memory_screen(screen);
+  delete_arena(arena);
+}
+
+static void bench_theme(Theme *theme, int argc, char *argv[]) {
+  int y_margin = theme->y_margin;
+  int i;
+  if (show_menu && theme->y_margin < 2) {
+    theme->y_margin = 2;
+  }
+  cache_glyphs(theme);
+  if (argc) {
+    for (i = 0; i < argc; i++) {
+      bench_render(theme, get_game(argv[i]));
+    }
+  } else {
+    GameList *list;
+    for (list = list_games(); list; list = list->next) {
+      bench_render(theme, list->game);
+    }
+  }
+  theme->y_margin = y_margin;
+}
+
+static void describe_usage(const char *program) {
+  printf("usage: %s [-j] [-t seconds] [-c file] [-s WxH] [-T theme] [game...]\n", program);
+  puts("  -j          print the results as JSON instead of CSV");
+  puts("  -t seconds  minimum time for each measurement (default 0.2)");
+  puts("  -c file     configuration file that defines the games (default csolrc)");
+  puts("  -s WxH      size of the screen in columns and lines (default 80x24)");
+  puts("  -T theme    only measure one theme");
+}
+
+int main(int argc, char *argv[]) {
+  char *rc_file = "csolrc";
+  char *theme_name = NULL;
+  int i, first_game = argc;
+  for (i = 1; i < argc && first_game == argc; i++) {
+    if (strcmp(argv[i], "-j") == 0) {
+      json = 1;
+    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      min_time = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      rc_file = argv[++i];
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      if (sscanf(argv[++i], "%dx%d", &screen_width, &screen_height) != 2
+          || screen_width < 1 || screen_height < 1) {
+        describe_usage(argv[0]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) {
+      theme_name = argv[++i];
+    } else if (argv[i][0] == '-') {
+      describe_usage(argv[0]);
+      return 1;
+    } else {
+      first_game = i;
+    }
+  }
+  if (!execute_file(rc_file)) {
+    return 1;
+  }
+  load_game_dirs();
+  for (i = first_game; i < argc; i++) {
+    if (!get_game(argv[i])) {
+      printf("game not found: '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+  if (theme_name) {
+    Theme *theme = get_theme(theme_name);
+    if (!theme) {
+      printf("theme not found: '%s'\n", theme_name);
+      return 1;
+    }
+    bench_theme(theme, argc - first_game, argv + first_game);
+  } else {
+    ThemeList *list;
+    load_theme_dirs();
+    for (list = list_themes(); list; list = list->next) {
+      bench_theme(list->theme, argc - first_game, argv + first_game);
+    }
+  }
+  free_glyphs();
+  if (json) {
+    printf("%s\n", results ? "\n]" : "[]");
+  }
+  return 0;
+}
@@ -0,0 +1,11 @@
+# Runs csol --perft on GAME for seed 1 at depth 4 and fails unless the total
+# number of nodes is NODES. See the perft tests in CMakeLists.txt.
+execute_process(COMMAND ${CSOL} -c ${CSOLRC} --perft ${GAME} --seed 1 --depth 4
+  OUTPUT_VARIABLE output RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "perft failed for ${GAME}:\n${output}")
+endif()
+string(REGEX MATCH "nodes: ([0-9]+)" match "${output}")
+if(NOT "${CMAKE_MATCH_1}" STREQUAL "${NODES}")
+  message(FATAL_ERROR "${GAME}: expected ${NODES} nodes, got ${CMAKE_MATCH_1}")
+endif()
@@ -0,0 +1,153 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#include "arena.h"
+
+#include <stdlib.h>
+
+typedef struct arena_block ArenaBlock;
+typedef struct arena_buffer ArenaBuffer;
+
+/* Allocations are aligned to the size of this union */
+typedef union {
+  long l;
+  double d;
+  void *p;
+} ArenaAlign;
+
+#define ALIGN(size) (((size) + sizeof(ArenaAlign) - 1) / sizeof(ArenaAlign) * sizeof(ArenaAlign))
+
+struct arena_block {
+  ArenaBlock *next;
+  size_t size;
+  size_t used;
+  ArenaAlign data[1];
+};
+
+/* A buffer allocated with arena_resize */
+struct arena_buffer {
+  ArenaBuffer *next;
+  ArenaBuffer *prev;
+  ArenaAlign data[1];
+};
+
+#define BUFFER_HEADER_SIZE offsetof(ArenaBuffer, data)
+
+struct arena {
+  ArenaBlock *blocks;
+  ArenaBuffer *buffers;
+  size_t block_size;
+  size_t total_size;
+  ArenaStats stats;
+};
+
+static ArenaBlock *new_arena_block(size_t size, ArenaBlock *next) {
+  ArenaBlock *block = malloc(sizeof(ArenaBlock) - sizeof(ArenaAlign) + size);
+  block->next = next;
+  block->size = size;
+  block->used = 0;
+  return block;
+}
+
+Arena *new_arena(size_t block_size) {
+  Arena *arena = malloc(sizeof(Arena));
+  arena->block_size = ALIGN(block_size);
+  arena->blocks = new_arena_block(arena->block_size, NULL);
+  arena->buffers = NULL;
+  arena->total_size = arena->block_size;
+  arena->stats.allocations = 0;
+  arena->stats.blocks = 1;
+  return arena;
+}
+
+static void delete_blocks(ArenaBlock *block) {
+  while (block) {
+    ArenaBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+}
+
+static void delete_buffers(Arena *arena) {
+  ArenaBuffer *buffer = arena->buffers;
+  while (buffer) {
+    ArenaBuffer *next = buffer->next;
+    free(buffer);
+    buffer = next;
+  }
+  arena->buffers = NULL;
+}
+
+void delete_arena(Arena *arena) {
+  delete_blocks(arena->blocks);
+  delete_buffers(arena);
+  free(arena);
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+  ArenaBlock *block = arena->blocks;
+  void *p;
+  size = ALIGN(size);
+  if (block->size - block->used < size) {
+    size_t block_size = arena->block_size;
+    if (size > block_size) {
+      block_size = size;
+    }
+    block = arena->blocks = new_arena_block(block_size, block);
+    arena->total_size += block_size;
+    arena->stats.blocks++;
+  }
+  arena->stats.allocations++;
+  p = (char *)block->data + block->used;
+  block->used += size;
+  return p;
+}
+
+/* Allocates a buffer if `p` is NULL, or resizes a buffer previously returned
+ * by arena_resize. Unlike memory from arena_alloc, the old copy of a resized
+ * buffer is freed at once, so a buffer can keep growing without leaving
+ * superseded copies behind. Buffers are freed with the rest of the arena. */
+void *arena_resize(Arena *arena, void *p, size_t size) {
+  ArenaBuffer *buffer = p ? (ArenaBuffer *)((char *)p - BUFFER_HEADER_SIZE) : NULL;
+  ArenaBuffer *resized = realloc(buffer, BUFFER_HEADER_SIZE + size);
+  if (!buffer) {
+    resized->prev = NULL;
+    resized->next = arena->buffers;
+    if (arena->buffers) {
+      arena->buffers->prev = resized;
+    }
+    arena->buffers = resized;
+  } else if (resized != buffer) {
+    if (resized->prev) {
+      resized->prev->next = resized;
+    } else {
+      arena->buffers = resized;
+    }
+    if (resized->next) {
+      resized->next->prev = resized;
+    }
+  }
+  arena->stats.allocations++;
+  return resized->data;
+}
+
+/* Frees everything allocated from the arena. If the arena had grown beyond
+ * its first block, the blocks are replaced by a single block large enough to
+ * hold all of them, so that refilling the arena in the same way doesn't need
+ * any more allocations. */
+void clear_arena(Arena *arena) {
+  if (arena->blocks->next) {
+    delete_blocks(arena->blocks);
+    arena->blocks = new_arena_block(arena->total_size, NULL);
+    arena->stats.blocks++;
+  }
+  arena->blocks->used = 0;
+  delete_buffers(arena);
+}
+
+void get_arena_stats(Arena *arena, ArenaStats *stats) {
+  *stats = arena->stats;
+}
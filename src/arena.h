@@ -0,0 +1,31 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* A region of memory that objects are allocated from one after another and
+ * freed all at once. */
+typedef struct arena Arena;
+typedef struct arena_stats ArenaStats;
+
+/* Number of calls to arena_alloc and number of blocks allocated with malloc
+ * since the arena was created */
+struct arena_stats {
+  unsigned long allocations;
+  unsigned long blocks;
+};
+
+Arena *new_arena(size_t block_size);
+void delete_arena(Arena *arena);
+void *arena_alloc(Arena *arena, size_t size);
+void *arena_resize(Arena *arena, void *p, size_t size);
+void clear_arena(Arena *arena);
+void get_arena_stats(Arena *arena, ArenaStats *stats);
+
+#endif
@@ -6,51 +6,79 @@
 
 #include "card.h"
 
-#include <stdlib.h>
+#include <assert.h>
 
 char suits[] = {HEART, DIAMOND, SPADE, CLUB};
 
-Card *new_card(char suit, char rank) {
-  Card *card = malloc(sizeof(Card));
-  card->prev = NULL;
-  card->next = NULL;
+/* Maps a card to a number between 0 and CARD_IDS - 1. Bottom cards get 0. */
+static char card_id(char suit, char rank) {
+  int i;
+  for (i = 0; i < 4; i++) {
+    if (suits[i] == suit) {
+      return i * 13 + rank - 1;
+    }
+  }
+  return 0;
+}
+
+void init_card(Card *card, char suit, char rank) {
+  card->stack = NULL;
+  card->index = 0;
   card->x = 0;
   card->y = 0;
   card->up = 1;
   card->suit = suit;
   card->rank = rank;
-  return card;
+  card->id = card_id(suit, rank);
 }
 
-void delete_stack(Card *stack) {
-  if (stack->next) {
-    delete_stack(stack->next);
-  }
-  free(stack);
+Card *init_stack(Stack *stack, Card *bottom, Card **cards, int capacity, char suit, char rank) {
+  init_card(bottom, suit, rank);
+  stack->cards = cards;
+  stack->cards[0] = bottom;
+  stack->size = 1;
+  stack->capacity = capacity;
+  stack->id = 0;
+  bottom->stack = stack;
+  return bottom;
+}
+
+/* Stacks are sized for every card in the deal when they are created, see
+ * init_stack */
+static void append_card(Stack *stack, Card *card) {
+  assert(stack->size < stack->capacity);
+  card->stack = stack;
+  card->index = stack->size;
+  stack->cards[stack->size++] = card;
+}
+
+void push_card(Card *stack, Card *card) {
+  append_card(stack->stack, card);
 }
 
 int count_stack(Card *stack) {
-  int n = 0;
-  while (stack) {
-    n++;
-    stack = stack->next;
+  if (!stack) {
+    return 0;
   }
-  return n;
+  if (!stack->stack) {
+    return 1;
+  }
+  return stack->stack->size - stack->index;
 }
 
-Card *new_deck(int decks, int deck_suits) {
+Card *new_deck(Arena *arena, int decks, int deck_suits) {
   int i;
   char suit, rank;
-  Card *deck = new_card(BOTTOM, 0);
-  Card *prev = deck;
+  int capacity = decks * 52 + 1;
+  Card *cards = arena_alloc(arena, capacity * sizeof(Card));
+  Card *deck = init_stack(arena_alloc(arena, sizeof(Stack)), cards++,
+      arena_alloc(arena, capacity * sizeof(Card *)), capacity, BOTTOM, 0);
   for (i = 0; i < decks; i++) {
     for (suit = 0; suit < 4; suit++) {
       if (deck_suits & (1 << suit)) {
         for (rank = 1; rank <= 13; rank++) {
-          Card *card = new_card(suits[(int)suit], rank);
-          prev->next = card;
-          card->prev = prev;
-          prev = card;
+          init_card(cards, suits[(int)suit], rank);
+          append_card(deck->stack, cards++);
         }
       }
     }
@@ -58,86 +86,67 @@ Card *new_deck(int decks, int deck_suits) {
   return deck;
 }
 
-Card *shuffle_stack(Card *stack) {
-  Card *new, *next;
-  int n = 2;
-  if (!stack->next) {
-    return stack;
+void shuffle_stack(Card *stack, Rng *rng) {
+  Card **cards;
+  int i, index;
+  if (!stack || !stack->stack) {
+    return;
   }
-  new = stack;
-  next = stack->next;
-  new->next = NULL;
-  new->prev = NULL;
-  while (next) {
-    Card *next_next = next->next;
-    int i = rand() % n;
-    if (i == 0) {
-      new->prev = next;
-      next->prev = NULL;
-      next->next = new;
-      new = next;
-    } else {
-      int j;
-      Card *c = new;
-      for (j = 1; j < i; j++) {
-        c = c->next;
-      }
-      if (c->next) {
-        c->next->prev = next;
-      }
-      next->next = c->next;
-      c->next = next;
-      next->prev = c;
-    }
-    n++;
-    next = next_next;
+  index = stack->index;
+  cards = stack->stack->cards + index;
+  for (i = count_stack(stack) - 1; i > 0; i--) {
+    int j = (int)rng_range(rng, (uint32_t)(i + 1));
+    Card *card = cards[i];
+    cards[i] = cards[j];
+    cards[j] = card;
+    cards[i]->index = index + i;
   }
-  return new;
+  cards[0]->index = index;
 }
 
-Card *take_card(Card *card) {
-  if (card->prev) {
-    card->prev->next = card->next;
+void move_stack(Card *dest, Card *src) {
+  Stack *dest_stack = dest->stack;
+  Stack *src_stack = src->stack;
+  int i, index;
+  if (!src_stack) {
+    append_card(dest_stack, src);
+    return;
   }
-  if (card->next) {
-    card->next->prev = card->prev;
+  index = src->index;
+  for (i = index; i < src_stack->size; i++) {
+    append_card(dest_stack, src_stack->cards[i]);
   }
-  card->prev = NULL;
-  card->next = NULL;
-  return card;
+  src_stack->size = index;
 }
 
-Card *take_stack(Card *stack) {
-  if (stack->prev) {
-    stack->prev->next = NULL;
+Card *next_card(Card *card) {
+  if (card->stack && card->index + 1 < card->stack->size) {
+    return card->stack->cards[card->index + 1];
   }
-  stack->prev = NULL;
-  return stack;
+  return NULL;
 }
 
-void move_stack(Card *dest, Card *src) {
-  if (dest->next) {
-    move_stack(dest->next, src);
-  } else {
-    dest->next = src;
-    if (src->prev) src->prev->next = NULL;
-    src->prev = dest;
+Card *prev_card(Card *card) {
+  if (card->stack && card->index > 0) {
+    return card->stack->cards[card->index - 1];
   }
+  return NULL;
 }
 
 Card *get_bottom(Card *stack) {
-  if (stack->prev)
-    return get_bottom(stack->prev);
+  if (stack->stack) {
+    return stack->stack->cards[0];
+  }
   return stack;
 }
 
 Card *get_top(Card *stack) {
-  if (stack->next)
-    return get_top(stack->next);
+  if (stack->stack) {
+    return stack->stack->cards[stack->stack->size - 1];
+  }
   return stack;
 }
 
 char get_stack_type(Card *stack) {
   return get_bottom(stack)->suit;
 }
-
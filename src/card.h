@@ -7,6 +7,9 @@
 #ifndef CARD_H
 #define CARD_H
 
+#include "arena.h"
+#include "rng.h"
+
 /* Card suit bit masks:
  *
  * BOTTOM:     00000001
@@ -41,6 +44,9 @@
 #define IS_BOTTOM(card) ((card)->suit & BOTTOM)
 #define NOT_BOTTOM(card) (!((card)->suit & BOTTOM))
 
+/* Number of distinct cards, used to index per-card tables */
+#define CARD_IDS 52
+
 #define DECK_HEART   0x01
 #define DECK_DIAMOND 0x02
 #define DECK_SPADE   0x04
@@ -49,25 +55,41 @@
 extern char suits[];
 
 typedef struct card Card;
+typedef struct stack Stack;
+
+/* A pile of cards stored bottom to top in a contiguous array. The first card
+ * is usually a BOTTOM card marking the (empty) pile itself. */
+struct stack {
+  Card **cards;
+  int size;
+  int capacity;
+  /* Identifies the stack when hashing card positions */
+  int id;
+};
 
 struct card {
-  Card *prev;
-  Card *next;
+  Stack *stack;
+  int index;
   int x;
   int y;
   char up;
   char suit;
   char rank;
+  char id;
 }; 
 
-Card *new_card(char suit, char rank);
-void delete_stack(Card *stack);
+void init_card(Card *card, char suit, char rank);
+/* Initializes a stack in memory owned by the caller. `cards` must have room
+ * for `capacity` cards, and the stack must never grow beyond that. */
+Card *init_stack(Stack *stack, Card *bottom, Card **cards, int capacity, char suit, char rank);
 int count_stack(Card *stack);
-Card *new_deck(int decks, int deck_suits);
-Card *shuffle_stack(Card *stack);
-Card *take_card(Card *card);
-Card *take_stack(Card *stack);
+/* Allocates the deck from `arena`. It is freed along with the arena. */
+Card *new_deck(Arena *arena, int decks, int deck_suits);
+void shuffle_stack(Card *stack, Rng *rng);
+void push_card(Card *stack, Card *card);
 void move_stack(Card *dest, Card *src);
+Card *next_card(Card *card);
+Card *prev_card(Card *card);
 Card *get_bottom(Card *stack);
 Card *get_top(Card *stack);
 char get_stack_type(Card *stack);
@@ -6,23 +6,22 @@
 
 #include "error.h"
 
-#include <stdarg.h>
-#ifdef USE_PDCURSES
-#include <curses.h>
-#else
-#include <ncurses.h>
-#endif
+#include <stdio.h>
+
+static ErrorHandler error_handler = NULL;
+
+void set_error_handler(ErrorHandler handler) {
+  error_handler = handler;
+}
 
 void print_error(const char *format, ...) {
   va_list va;
-  clear();
-  wmove(stdscr, 0, 0);
   va_start(va, format);
-  vw_printw(stdscr, format, va);
-  printw("\nPress any key to continue");
+  if (error_handler) {
+    error_handler(format, va);
+  } else {
+    vprintf(format, va);
+    printf("\n");
+  }
   va_end(va);
-  refresh();
-  getch();
-  clear();
 }
-
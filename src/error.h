@@ -7,6 +7,14 @@
 #ifndef ERROR_H
 #define ERROR_H
 
+#include <stdarg.h>
+
+typedef void (*ErrorHandler)(const char *format, va_list va);
+
+/* Replaces the function used by print_error. NULL restores the default,
+ * which prints to the standard output. */
+void set_error_handler(ErrorHandler handler);
+
 void print_error(const char *format, ...);
 
 #endif
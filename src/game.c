@@ -10,6 +10,8 @@
 #include "rc.h"
 #include "util.h"
 
+#include <assert.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -24,26 +26,53 @@ GameList *last_game = NULL;
 
 struct dir_list *game_dirs = NULL;
 
-struct move {
-  struct move *prev;
+/* An entry in the undo history. A move that consists of several records is
+ * stored as consecutive records where all but the first are marked as
+ * combined. */
+struct record {
   Card *stack;
   Card *src;
-  char up;
   Pile *stock;
   Pile *waste;
-  struct move *next_combined;
+  unsigned long serial;
+  char up;
+  char combined;
 };
 
-struct move *undo_moves = NULL;
-struct move *redo_moves = NULL;
+/* Initial number of records in the undo history */
+#define HISTORY_CAPACITY 64
+
+#define HISTORY_RECORD(state, i) (&(state)->history[(i) & ((state)->history_capacity - 1)])
+
+/* Bit table of the cards allowed on top of each card for a given combination
+ * of next_suit and next_rank. Tables are shared by all rules using the same
+ * combination. */
+struct rule_table {
+  RuleTable *next;
+  GameRuleSuit suit;
+  GameRuleRank rank;
+  uint32_t cards[CARD_IDS][2];
+};
 
-int move_counter = 0;
-int32_t game_score = 0;
+#define HAS_CARD(bits, id) (((bits)[(id) >> 5] >> ((id) & 31)) & 1)
 
-char *move_error = NULL;
+RuleTable *rule_tables = NULL;
+
+/* Games, rules and rule tables live until the program exits, so they are
+ * allocated from a single arena that is never freed. */
+static Arena *config_arena = NULL;
+
+#define CONFIG_ARENA_SIZE 16384
+
+static void *config_alloc(size_t size) {
+  if (!config_arena) {
+    config_arena = new_arena(CONFIG_ARENA_SIZE);
+  }
+  return arena_alloc(config_arena, size);
+}
 
 Game *new_game() {
-  Game *game = malloc(sizeof(Game));
+  Game *game = config_alloc(sizeof(Game));
   game->name = NULL;
   game->title = NULL;
   game->decks = 1;
@@ -54,7 +83,7 @@ Game *new_game() {
 }
 
 GameRule *new_game_rule(GameRuleType type) {
-  GameRule *rule = malloc(sizeof(GameRule));
+  GameRule *rule = config_alloc(sizeof(GameRule));
   rule->next = NULL;
   rule->type = type;
   rule->x = 0;
@@ -74,6 +103,8 @@ GameRule *new_game_rule(GameRuleType type) {
   rule->turn = 0;
   rule->same_class = NULL;
   rule->valid_group = NULL;
+  rule->first_cards[0] = rule->first_cards[1] = 0;
+  rule->next_cards = NULL;
   switch (type) {
     case RULE_FOUNDATION:
       rule->first_rank = RANK_ACE;
@@ -106,9 +137,15 @@ GameRule *new_game_rule(GameRuleType type) {
   return rule;
 }
 
+static void compile_game_rule(GameRule *rule);
+
 void register_game(Game *game) {
+  GameRule *rule;
+  for (rule = game->first_rule; rule; rule = rule->next) {
+    compile_game_rule(rule);
+  }
   if (game->name) {
-    GameList *next = malloc(sizeof(GameList));
+    GameList *next = config_alloc(sizeof(GameList));
     next->game = game;
     next->next = NULL;
     if (last_game) {
@@ -179,80 +216,451 @@ Game *get_game(const char *name) {
   return get_game_in_list(name);
 }
 
-Card *new_pile(GameRule *rule) {
-  char rank = 0;
-  if (rule->first_rank <= RANK_KING) {
-    rank = (char)rule->first_rank;
+static uint64_t mix_hash(uint64_t z) {
+  z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+  z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+  return z ^ (z >> 31);
+}
+
+/* Zobrist keys are derived from a strong mixing function instead of being
+ * stored in a table, since a table covering every position of every pile
+ * would be large for multi-deck games. */
+static uint64_t card_key(Card *card) {
+  return mix_hash((uint64_t)card->stack->id << 24 | (uint64_t)card->index << 8
+      | (uint64_t)card->id << 1 | (uint64_t)!!card->up);
+}
+
+static uint64_t redeals_key(Pile *pile) {
+  return mix_hash(UINT64_C(1) << 48 | (uint64_t)pile->index << 24 | (uint64_t)pile->redeals);
+}
+
+static void hash_stack(GameState *state, Card *stack) {
+  Card **cards = stack->stack->cards;
+  int i, size = stack->stack->size;
+  state->damage[stack->stack->id] = 1;
+  for (i = stack->index; i < size; i++) {
+    state->hash ^= card_key(cards[i]);
   }
-  switch (rule->type) {
-    case RULE_TABLEAU:
-      return new_card(TABLEAU, rank);
-    case RULE_STOCK:
-    case RULE_FOUNDATION:
-    case RULE_WASTE:
-    case RULE_CELL:
-      return new_card(FOUNDATION, rank);
-    default:
-      /* TODO: error */
-      return NULL;
+}
+
+static void hash_move_stack(GameState *state, Card *dest, Card *src) {
+  hash_stack(state, src);
+  move_stack(dest, src);
+  hash_stack(state, src);
+}
+
+static void hash_set_up(GameState *state, Card *card, char up) {
+  state->damage[card->stack->id] = 1;
+  state->hash ^= card_key(card);
+  card->up = up;
+  state->hash ^= card_key(card);
+}
+
+static void hash_set_redeals(GameState *state, Pile *pile, int redeals) {
+  state->damage[pile->index] = 1;
+  state->hash ^= redeals_key(pile);
+  pile->redeals = redeals;
+  state->hash ^= redeals_key(pile);
+}
+
+uint64_t hash_piles(Pile *piles) {
+  uint64_t hash = 0;
+  Pile *pile;
+  for (pile = piles; pile; pile = pile->next) {
+    Card **cards = pile->stack->stack->cards;
+    int i, size = pile->stack->stack->size;
+    for (i = 1; i < size; i++) {
+      hash ^= card_key(cards[i]);
+    }
+    hash ^= redeals_key(pile);
   }
+  return hash;
 }
 
-void deal_pile(Card *stack, GameRule *rule, Card *deck) {
+/* Deals cards to a pile by copying them from the deck into the board. */
+static void deal_pile(Card *stack, GameRule *rule, Card **deck, int deck_size, int *dealt, Card *board_cards) {
   if (rule->deal > 0) {
-    int i;
-    for (i = 0; i < rule->deal && deck->next; i++) {
-      move_stack(stack, take_card(deck->next));
+    Card **cards;
+    int i, size;
+    for (i = 0; i < rule->deal && *dealt < deck_size; i++) {
+      Card *card = &board_cards[*dealt];
+      *card = *deck[(*dealt)++];
+      push_card(stack, card);
     }
+    cards = stack->stack->cards;
+    size = stack->stack->size;
     if (rule->hide > 0) {
-      Card *card = stack->next;
-      int i;
-      for (i = 0; i < rule->hide && card; i++, card = card->next) {
-        card->up = 0;
-      }
-      for (; card; card = card->next) {
-        card->up = 1;
+      for (i = 1; i < size; i++) {
+        cards[i]->up = i > rule->hide;
       }
     } else if (rule->hide < 0) {
-      Card *card = get_top(stack);
-      int i, hide = -rule->hide;
-      for (i = 0; i < hide && !(card->suit & BOTTOM); i++, card = card->prev) {
-        card->up = 1;
+      for (i = 1; i < size; i++) {
+        cards[i]->up = i >= size + rule->hide;
       }
-      for (; !(card->suit & BOTTOM); card = card->prev) {
-        card->up = 0;
+    }
+    if (rule->type == RULE_STOCK) {
+      for (i = 1; i < size; i++) {
+        cards[i]->up = 0;
       }
     }
   }
 }
 
-void delete_piles(Pile *piles) {
-  if (piles->next) {
-    delete_piles(piles->next);
-  }
-  delete_stack(piles->stack);
-  free(piles);
-}
-
-Pile *deal_cards(Game *game, Card *deck) {
-  Pile *first = NULL;
-  Pile *last = NULL;
+/* The board (piles, stacks, cards and the card arrays of the stacks) is
+ * allocated as one block, so that it can be copied by state_snapshot and
+ * state_restore without fixing up any pointers. Every stack has room for all
+ * the cards in the deck. Everything is allocated from `arena` and freed by
+ * clearing it. The piles are left empty. */
+static GameState *alloc_game_state(Arena *arena, Game *game, int deck_size) {
+  GameState *state = arena_alloc(arena, sizeof(GameState));
   GameRule *rule;
+  Pile *piles, *last = NULL;
+  Stack *stacks;
+  Card *bottoms, **slots;
+  int count = 0, i = 0;
   for (rule = game->first_rule; rule; rule = rule->next) {
-    Pile *pile = malloc(sizeof(Pile));
+    count++;
+  }
+  state->board_size = count * (sizeof(Pile) + sizeof(Stack) + sizeof(Card) + (deck_size + 1) * sizeof(Card *))
+    + deck_size * sizeof(Card);
+  state->board = arena_alloc(arena, state->board_size);
+  piles = state->board;
+  stacks = (Stack *)(piles + count);
+  bottoms = (Card *)(stacks + count);
+  slots = (Card **)(bottoms + count + deck_size);
+  for (rule = game->first_rule; rule; rule = rule->next, i++) {
+    Pile *pile = &piles[i];
+    char rank = 0;
+    if (rule->first_rank <= RANK_KING) {
+      rank = (char)rule->first_rank;
+    }
     pile->next = NULL;
     pile->rule = rule;
-    pile->stack = new_pile(rule);
+    pile->stack = init_stack(&stacks[i], &bottoms[i], slots + i * (deck_size + 1), deck_size + 1,
+        rule->type == RULE_TABLEAU ? TABLEAU : FOUNDATION, rank);
     pile->redeals = 0;
-    deal_pile(pile->stack, pile->rule, deck);
+    pile->index = i;
+    pile->stack->stack->id = i;
     if (last) {
       last->next = pile;
-      last = pile;
-    } else {
-      first = last = pile;
+    }
+    last = pile;
+  }
+  state->piles = count ? piles : NULL;
+  state->pile_count = count;
+  state->damage = arena_alloc(arena, count + 1);
+  memset(state->damage, 1, count + 1);
+  state->deck_size = deck_size;
+  state->move_counter = 0;
+  state->score = 0;
+  state->hash = 0;
+  state->move_error = NULL;
+  state->arena = arena;
+  state->history = NULL;
+  state->history_capacity = 0;
+  state->history_start = 0;
+  state->undo_end = 0;
+  state->redo_end = 0;
+  state->undo_length = 0;
+  state->undo_limit = 0;
+  state->serial = 0;
+  state->log_moves = 0;
+  state->log = NULL;
+  state->log_size = 0;
+  state->log_capacity = 0;
+  return state;
+}
+
+/* Returns the bottom cards of the piles, which are followed by the dealt
+ * cards. Cards are identified by their index in this array when the state is
+ * serialized. */
+static Card *get_board_cards(GameState *state) {
+  return (Card *)((Stack *)((Pile *)state->board + state->pile_count) + state->pile_count);
+}
+
+GameState *new_game_state(Arena *arena, Game *game, Card *deck) {
+  Card **deck_cards = deck->stack->cards + deck->index + 1;
+  int deck_size = count_stack(deck) - 1;
+  GameState *state = alloc_game_state(arena, game, deck_size);
+  Card *board_cards = get_board_cards(state) + state->pile_count;
+  Pile *pile;
+  int dealt = 0;
+  for (pile = state->piles; pile; pile = pile->next) {
+    deal_pile(pile->stack, pile->rule, deck_cards, deck_size, &dealt, board_cards);
+  }
+  state->hash = hash_piles(state->piles);
+  return state;
+}
+
+Snapshot *new_snapshot(GameState *state) {
+  Snapshot *snapshot = malloc(sizeof(Snapshot) + state->board_size);
+  snapshot->board = snapshot + 1;
+  state_snapshot(state, snapshot);
+  return snapshot;
+}
+
+void delete_snapshot(Snapshot *snapshot) {
+  free(snapshot);
+}
+
+void state_snapshot(GameState *state, Snapshot *snapshot) {
+  memcpy(snapshot->board, state->board, state->board_size);
+  snapshot->move_counter = state->move_counter;
+  snapshot->score = state->score;
+  snapshot->hash = state->hash;
+  snapshot->undo_end = state->undo_end;
+  snapshot->log_size = state->log_size;
+  snapshot->serial = state->undo_end > state->history_start ? HISTORY_RECORD(state, state->undo_end - 1)->serial : 0;
+}
+
+/* Moves recorded after the snapshot are dropped from the undo history. If
+ * moves from before the snapshot have been undone or dropped in the meantime,
+ * the whole history is dropped. */
+void state_restore(GameState *state, Snapshot *snapshot) {
+  clear_redo_history(state);
+  if (snapshot->undo_end >= state->history_start && snapshot->undo_end <= state->undo_end
+      && (snapshot->undo_end == state->history_start
+        || HISTORY_RECORD(state, snapshot->undo_end - 1)->serial == snapshot->serial)) {
+    while (state->undo_end > snapshot->undo_end) {
+      if (!HISTORY_RECORD(state, --state->undo_end)->combined) {
+        state->undo_length--;
+      }
+    }
+    state->redo_end = state->undo_end;
+  } else {
+    clear_undo_history(state);
+  }
+  if (snapshot->log_size < state->log_size) {
+    state->log_size = snapshot->log_size;
+  }
+  memcpy(state->board, snapshot->board, state->board_size);
+  memset(state->damage, 1, state->pile_count);
+  state->move_counter = snapshot->move_counter;
+  state->score = snapshot->score;
+  state->hash = snapshot->hash;
+  state->move_error = NULL;
+}
+
+/* Serialized states contain card numbers (indices in the array returned by
+ * get_board_cards) and pile indices. These values mean no card and no pile. */
+#define NO_CARD 0xFFFF
+#define NO_PILE 0xFF
+
+typedef struct {
+  const unsigned char *data;
+  const unsigned char *end;
+  int error;
+} Reader;
+
+static unsigned char *put_uint(unsigned char *p, uint32_t value, int bytes) {
+  int i;
+  for (i = 0; i < bytes; i++) {
+    *(p++) = (value >> (8 * i)) & 0xFF;
+  }
+  return p;
+}
+
+static uint32_t get_uint(Reader *r, int bytes) {
+  uint32_t value = 0;
+  int i;
+  if (r->end - r->data < bytes) {
+    r->error = 1;
+    return 0;
+  }
+  for (i = 0; i < bytes; i++) {
+    value |= (uint32_t)*(r->data++) << (8 * i);
+  }
+  return value;
+}
+
+static unsigned int card_number(GameState *state, Card *card) {
+  return card ? (unsigned int)(card - get_board_cards(state)) : NO_CARD;
+}
+
+/* Serializes the board, counters, undo history and move log in a compact
+ * format that doesn't depend on pointers. If `history_limit` is positive, at
+ * most that many moves are included from each end of the undo history. The
+ * buffer is allocated with malloc. */
+unsigned char *serialize_game_state(GameState *state, int history_limit, size_t *size) {
+  Card *cards = get_board_cards(state);
+  unsigned char *data, *p;
+  unsigned long i, first = state->history_start, last = state->redo_end;
+  int card_count = 0;
+  Pile *pile;
+  for (pile = state->piles; pile; pile = pile->next) {
+    card_count += pile->stack->stack->size - 1;
+  }
+  if (history_limit > 0) {
+    int moves = 0;
+    first = state->undo_end;
+    while (first > state->history_start && moves < history_limit) {
+      if (!HISTORY_RECORD(state, --first)->combined) {
+        moves++;
+      }
+    }
+    last = state->undo_end;
+    for (moves = 0; last < state->redo_end && moves < history_limit; moves++) {
+      do {
+        last++;
+      } while (last < state->redo_end && HISTORY_RECORD(state, last)->combined);
     }
   }
-  return first;
+  *size = 4 + 4 + 2 + 2 + 2 + card_count + state->pile_count * 4 + card_count * 2
+    + 4 + 4 + (last - first) * 7 + 4 + state->log_size * 4;
+  p = data = malloc(*size);
+  p = put_uint(p, state->move_counter, 4);
+  p = put_uint(p, state->score, 4);
+  p = put_uint(p, state->pile_count, 2);
+  p = put_uint(p, state->deck_size, 2);
+  p = put_uint(p, card_count, 2);
+  for (i = 0; i < (unsigned long)card_count; i++) {
+    Card *card = &cards[state->pile_count + i];
+    *(p++) = card->id | (card->up ? 0x80 : 0);
+  }
+  for (pile = state->piles; pile; pile = pile->next) {
+    Stack *stack = pile->stack->stack;
+    int j;
+    p = put_uint(p, pile->redeals, 2);
+    p = put_uint(p, stack->size - 1, 2);
+    for (j = 1; j < stack->size; j++) {
+      p = put_uint(p, card_number(state, stack->cards[j]) - state->pile_count, 2);
+    }
+  }
+  p = put_uint(p, state->undo_end - first, 4);
+  p = put_uint(p, last - state->undo_end, 4);
+  for (i = first; i < last; i++) {
+    struct record *m = HISTORY_RECORD(state, i);
+    p = put_uint(p, card_number(state, m->stack), 2);
+    p = put_uint(p, card_number(state, m->src), 2);
+    *(p++) = m->stock ? m->stock->index : NO_PILE;
+    *(p++) = m->waste ? m->waste->index : NO_PILE;
+    *(p++) = (m->up ? 1 : 0) | (m->combined ? 2 : 0);
+  }
+  p = put_uint(p, state->log_size, 4);
+  for (i = 0; i < (unsigned long)state->log_size; i++) {
+    p = put_uint(p, state->log[i], 4);
+  }
+  return data;
+}
+
+/* Recreates a state serialized by serialize_game_state. Returns NULL if the
+ * data is invalid or was saved for a different game layout. Memory allocated
+ * from `arena` before an error is detected is not released until the arena is
+ * cleared. */
+GameState *deserialize_game_state(Arena *arena, Game *game, const unsigned char *data, size_t size) {
+  Reader r;
+  GameState *state;
+  Card *cards;
+  Pile *pile;
+  char *used;
+  int32_t move_counter, score;
+  unsigned int pile_count, deck_size, card_count, card_total, i;
+  uint32_t undo_count, redo_count, log_size;
+  int capacity;
+  r.data = data;
+  r.end = data + size;
+  r.error = 0;
+  move_counter = (int32_t)get_uint(&r, 4);
+  score = (int32_t)get_uint(&r, 4);
+  pile_count = get_uint(&r, 2);
+  deck_size = get_uint(&r, 2);
+  card_count = get_uint(&r, 2);
+  if (r.error || deck_size > 0xFFF || card_count > deck_size) {
+    return NULL;
+  }
+  state = alloc_game_state(arena, game, deck_size);
+  if ((unsigned int)state->pile_count != pile_count) {
+    return NULL;
+  }
+  card_total = pile_count + card_count;
+  cards = get_board_cards(state);
+  for (i = 0; i < card_count; i++) {
+    unsigned int value = get_uint(&r, 1);
+    unsigned int id = value & 0x7F;
+    if (id >= CARD_IDS) {
+      return NULL;
+    }
+    init_card(&cards[pile_count + i], suits[id / 13], id % 13 + 1);
+    cards[pile_count + i].up = value >> 7;
+  }
+  used = arena_alloc(arena, card_count + 1);
+  memset(used, 0, card_count + 1);
+  for (pile = state->piles; pile; pile = pile->next) {
+    unsigned int n;
+    pile->redeals = get_uint(&r, 2);
+    n = get_uint(&r, 2);
+    if (r.error || n > card_count) {
+      return NULL;
+    }
+    while (n--) {
+      unsigned int number = get_uint(&r, 2);
+      if (r.error || number >= card_count || used[number]) {
+        return NULL;
+      }
+      used[number] = 1;
+      push_card(pile->stack, &cards[pile_count + number]);
+    }
+  }
+  for (i = 0; i < card_count; i++) {
+    if (!used[i]) {
+      return NULL;
+    }
+  }
+  undo_count = get_uint(&r, 4);
+  redo_count = get_uint(&r, 4);
+  if (r.error || undo_count > (uint32_t)(r.end - r.data) / 7 || redo_count > (uint32_t)(r.end - r.data) / 7) {
+    return NULL;
+  }
+  capacity = HISTORY_CAPACITY;
+  while ((uint32_t)capacity < undo_count + redo_count) {
+    capacity *= 2;
+  }
+  state->history = arena_resize(arena, NULL, capacity * sizeof(struct record));
+  state->history_capacity = capacity;
+  for (i = 0; i < undo_count + redo_count; i++) {
+    struct record *m = &state->history[i];
+    unsigned int stack = get_uint(&r, 2);
+    unsigned int src = get_uint(&r, 2);
+    unsigned int stock = get_uint(&r, 1);
+    unsigned int waste = get_uint(&r, 1);
+    unsigned int flags = get_uint(&r, 1);
+    if (r.error || (stack != NO_CARD && (stack < pile_count || stack >= card_total))
+        || (src != NO_CARD && src >= card_total) || (stock == NO_PILE) != (waste == NO_PILE)
+        || (stock == NO_PILE && stack == NO_CARD) || (stock != NO_PILE && (stock >= pile_count || waste >= pile_count))) {
+      return NULL;
+    }
+    m->stack = stack == NO_CARD ? NULL : &cards[stack];
+    m->src = src == NO_CARD ? NULL : &cards[src];
+    m->stock = stock == NO_PILE ? NULL : get_pile(state->piles, stock);
+    m->waste = waste == NO_PILE ? NULL : get_pile(state->piles, waste);
+    m->up = flags & 1;
+    m->combined = (flags & 2) != 0;
+    m->serial = ++state->serial;
+    if (m->combined && (i == 0 || i == undo_count)) {
+      return NULL;
+    }
+    if (i < undo_count && !m->combined) {
+      state->undo_length++;
+    }
+  }
+  state->undo_end = undo_count;
+  state->redo_end = undo_count + redo_count;
+  log_size = get_uint(&r, 4);
+  if (r.error || log_size != (uint32_t)(r.end - r.data) / 4 || (r.end - r.data) % 4) {
+    return NULL;
+  }
+  if (log_size) {
+    state->log = arena_resize(arena, NULL, log_size * sizeof(LogRecord));
+    state->log_capacity = log_size;
+    for (i = 0; i < log_size; i++) {
+      state->log[i] = get_uint(&r, 4);
+    }
+    state->log_size = log_size;
+  }
+  state->move_counter = move_counter;
+  state->score = score;
+  state->hash = hash_piles(state->piles);
+  return state;
 }
 
 int check_first_suit(Card *card, GameRuleSuit suit) {
@@ -328,154 +736,255 @@ int check_next_rank(Card *card, Card *previous, GameRuleRank rank) {
   }
 }
 
-int check_stack(Card *stack, GameRuleSuit suit, GameRuleRank rank) {
+static RuleTable *get_rule_table(GameRuleSuit suit, GameRuleRank rank) {
+  RuleTable *table;
+  Card card, previous;
+  for (table = rule_tables; table; table = table->next) {
+    if (table->suit == suit && table->rank == rank) {
+      return table;
+    }
+  }
+  table = config_alloc(sizeof(RuleTable));
+  memset(table, 0, sizeof(RuleTable));
+  table->suit = suit;
+  table->rank = rank;
+  for (previous.id = 0; previous.id < CARD_IDS; previous.id++) {
+    previous.suit = suits[previous.id / 13];
+    previous.rank = previous.id % 13 + 1;
+    for (card.id = 0; card.id < CARD_IDS; card.id++) {
+      card.suit = suits[card.id / 13];
+      card.rank = card.id % 13 + 1;
+      if (check_next_suit(&card, &previous, suit) && check_next_rank(&card, &previous, rank)) {
+        table->cards[(int)previous.id][card.id >> 5] |= UINT32_C(1) << (card.id & 31);
+      }
+    }
+  }
+  table->next = rule_tables;
+  rule_tables = table;
+  return table;
+}
+
+static void compile_game_rule(GameRule *rule) {
+  Card card;
+  rule->first_cards[0] = rule->first_cards[1] = 0;
+  for (card.id = 0; card.id < CARD_IDS; card.id++) {
+    card.suit = suits[card.id / 13];
+    card.rank = card.id % 13 + 1;
+    if (check_first_suit(&card, rule->first_suit) && check_first_rank(&card, rule->first_rank)) {
+      rule->first_cards[card.id >> 5] |= UINT32_C(1) << (card.id & 31);
+    }
+  }
+  rule->next_cards = get_rule_table(rule->next_suit, rule->next_rank);
+  if (rule->same_class) {
+    compile_game_rule(rule->same_class);
+  }
+  if (rule->valid_group) {
+    compile_game_rule(rule->valid_group);
+  }
+}
+
+static int check_first(Card *card, GameRule *rule) {
+  return HAS_CARD(rule->first_cards, card->id);
+}
+
+int check_next(Card *card, Card *previous, GameRule *rule) {
+  return HAS_CARD(rule->next_cards->cards[(int)previous->id], card->id);
+}
+
+static int check_stack(Card *stack, GameRule *rule) {
+  Card **cards;
+  int i, size;
+  uint32_t (*table)[2] = rule->next_cards->cards;
   if (!stack) {
     return 1;
   }
-  return check_next_suit(stack, stack->prev, suit) &&
-    check_next_rank(stack, stack->prev, rank) && check_stack(stack->next, suit, rank);
+  cards = stack->stack->cards;
+  size = stack->stack->size;
+  for (i = stack->index; i < size; i++) {
+    if (!HAS_CARD(table[(int)cards[i - 1]->id], cards[i]->id)) {
+      return 0;
+    }
+  }
+  return 1;
 }
 
-char *get_move_error() {
-  char *error = move_error;
+char *get_move_error(GameState *state) {
+  char *error = state->move_error;
   if (!error) {
     error = "";
   }
-  move_error = NULL;
+  state->move_error = NULL;
   return error;
 }
 
-static void delete_move(struct move *m) {
-  if (m->next_combined) {
-    delete_move(m->next_combined);
-  }
-  free(m);
+void clear_redo_history(GameState *state) {
+  state->redo_end = state->undo_end;
+}
+
+void clear_undo_history(GameState *state) {
+  state->history_start = state->undo_end = state->redo_end = 0;
+  state->undo_length = 0;
 }
 
-void clear_redo_history() {
-  while (redo_moves) {
-    struct move *m = redo_moves;
-    redo_moves = m->prev;
-    delete_move(m);
+/* Initial number of entries in the move log */
+#define LOG_CAPACITY 256
+
+static void log_move(GameState *state, LogType type, int src, int dest, int index) {
+  if (!state->log_moves) {
+    return;
+  }
+  if (state->log_size >= state->log_capacity) {
+    state->log_capacity = state->log_capacity ? state->log_capacity * 2 : LOG_CAPACITY;
+    state->log = arena_resize(state->arena, state->log, state->log_capacity * sizeof(LogRecord));
   }
+  state->log[state->log_size++] = LOG_RECORD(type, src, dest, index);
 }
 
-void clear_undo_history() {
-  clear_redo_history();
-  while (undo_moves) {
-    struct move *m = undo_moves;
-    undo_moves = m->prev;
-    delete_move(m);
+/* Doubles the capacity of the undo history in place. A record either keeps
+ * its position in the ring or moves to the new upper half, which is empty. */
+static void grow_history(GameState *state) {
+  unsigned long i;
+  int old_capacity = state->history_capacity;
+  state->history_capacity = old_capacity ? old_capacity * 2 : HISTORY_CAPACITY;
+  state->history = arena_resize(state->arena, state->history,
+      state->history_capacity * sizeof(struct record));
+  for (i = state->history_start; i < state->redo_end; i++) {
+    if (i & old_capacity) {
+      state->history[(i & (old_capacity - 1)) + old_capacity] = state->history[i & (old_capacity - 1)];
+    }
   }
 }
 
-static void record_move() {
-  struct move *m = malloc(sizeof(struct move));
-  clear_redo_history();
-  m->prev = undo_moves;
+/* Removes the oldest move from the undo history */
+static void drop_oldest_move(GameState *state) {
+  do {
+    state->history_start++;
+  } while (state->history_start < state->undo_end && HISTORY_RECORD(state, state->history_start)->combined);
+  state->undo_length--;
+}
+
+/* Adds a record to the undo history. If `combined` is set, the record is
+ * part of the same move as the previous record. */
+static void record_move(GameState *state, int combined) {
+  struct record *m;
+  clear_redo_history(state);
+  if (!state->undo_length) {
+    combined = 0;
+  }
+  if (!combined) {
+    if (state->undo_limit > 0) {
+      while (state->undo_length >= state->undo_limit) {
+        drop_oldest_move(state);
+      }
+    }
+    state->undo_length++;
+  }
+  if (state->undo_end - state->history_start >= (unsigned long)state->history_capacity) {
+    grow_history(state);
+  }
+  m = HISTORY_RECORD(state, state->undo_end);
+  state->undo_end++;
+  state->redo_end = state->undo_end;
   m->stack = NULL;
   m->src = NULL;
   m->up = 0;
   m->stock = NULL;
   m->waste = NULL;
-  m->next_combined = NULL;
-  undo_moves = m;
-}
-
-static void record_turn(Card *card) {
-  record_move();
-  undo_moves->stack = card;
-  undo_moves->up = card->up;
+  m->serial = ++state->serial;
+  m->combined = (char)combined;
 }
 
-static void record_location(Card *stack) {
-  record_turn(stack);
-  move_counter++;
-  undo_moves->src = stack->prev;
+static void record_turn(GameState *state, Card *card, int combined) {
+  struct record *m;
+  record_move(state, combined);
+  m = HISTORY_RECORD(state, state->undo_end - 1);
+  m->stack = card;
+  m->up = card->up;
 }
 
-static void record_redeal(Pile *stock, Pile *waste) {
-  record_move();
-  undo_moves->stock = stock;
-  undo_moves->waste = waste;
+static void record_location(GameState *state, Card *stack, int combined) {
+  record_turn(state, stack, combined);
+  state->move_counter++;
+  HISTORY_RECORD(state, state->undo_end - 1)->src = prev_card(stack);
 }
 
-static void combine_undo_moves() {
-  if (!undo_moves || !undo_moves->prev) {
-    return;
-  }
-  undo_moves->next_combined = undo_moves->prev;
-  undo_moves->prev = undo_moves->next_combined->prev;
-  undo_moves->next_combined->prev = NULL;
+static void record_redeal(GameState *state, Pile *stock, Pile *waste) {
+  struct record *m;
+  record_move(state, 0);
+  m = HISTORY_RECORD(state, state->undo_end - 1);
+  m->stock = stock;
+  m->waste = waste;
 }
 
-static void do_move(struct move *m, int inc) {
-  while (m) {
+static void do_move(GameState *state, unsigned long first, unsigned long last, int inc) {
+  while (last-- > first) {
+    struct record *m = HISTORY_RECORD(state, last);
     if (m->stock) {
       int from_stock;
       Card *src_card;
       Pile *stock = m->stock;
-      move_counter += inc;
+      state->move_counter += inc;
       from_stock = stock->rule->type == RULE_STOCK;
       if (from_stock) {
-        stock->redeals--;
-        game_score += 50;
+        hash_set_redeals(state, stock, stock->redeals - 1);
+        state->score += 50;
       } else {
-        m->waste->redeals++;
-        game_score -= 50;
+        hash_set_redeals(state, m->waste, m->waste->redeals + 1);
+        state->score -= 50;
       }
       src_card = get_top(stock->stack);
       while (!(src_card->suit & BOTTOM)) {
-        Card *prev = src_card->prev;
-        if (from_stock) {
-          prev->up = 1;
-        }
-        move_stack(m->waste->stack, src_card);
+        Card *prev = prev_card(src_card);
+        hash_set_up(state, src_card, from_stock);
+        hash_move_stack(state, m->waste->stack, src_card);
         src_card = prev;
       }
       m->stock = m->waste;
       m->waste = stock;
     } else {
       char up  = m->stack->up;
-      Card *dest = m->stack->prev;
-      m->stack->up = m->up;
+      Card *dest = prev_card(m->stack);
+      hash_set_up(state, m->stack, m->up);
       if (m->src) {
-        move_counter += inc;
-        move_stack(m->src, m->stack);
+        state->move_counter += inc;
+        hash_move_stack(state, m->src, m->stack);
         m->src = dest;
       }
       m->up = up;
     }
-    m = m->next_combined;
   }
 }
 
-static int pop_move_history(struct move **history1, struct move **history2, int inc) {
-  if (*history1) {
-    struct move *m = *history1;
-    *history1 = m->prev;
-    do_move(m, inc);
-    m->prev = *history2;
-    *history2 = m;
-    return 1;
-  }
-  return 0;
-}
-
-int undo_move() {
-  if (pop_move_history(&undo_moves, &redo_moves, -1)) {
-    game_score -= 20;
-    return 1;
+int undo_move(GameState *state) {
+  unsigned long first = state->undo_end;
+  if (!state->undo_length) {
+    return 0;
   }
-  return 0;
+  do {
+    first--;
+  } while (HISTORY_RECORD(state, first)->combined);
+  do_move(state, first, state->undo_end, -1);
+  state->undo_end = first;
+  state->undo_length--;
+  state->score -= 20;
+  log_move(state, LOG_UNDO, 0, 0, 0);
+  return 1;
 }
 
-int redo_move() {
-  if (pop_move_history(&redo_moves, &undo_moves, 1)) {
-    game_score += 20;
-    return 1;
+int redo_move(GameState *state) {
+  unsigned long last = state->undo_end;
+  if (state->undo_end == state->redo_end) {
+    return 0;
   }
-  return 0;
+  do {
+    last++;
+  } while (last < state->redo_end && HISTORY_RECORD(state, last)->combined);
+  do_move(state, state->undo_end, last, 1);
+  state->undo_end = last;
+  state->undo_length++;
+  state->score += 20;
+  log_move(state, LOG_REDO, 0, 0, 0);
+  return 1;
 }
 
 int count_free_cells(Pile *piles) {
@@ -483,169 +992,220 @@ int count_free_cells(Pile *piles) {
   int n = 0;
   for (dest = piles; dest; dest = dest->next) {
     if (dest->rule->type == RULE_CELL && dest->rule->first_rank == RANK_ANY
-        && dest->rule->first_suit == SUIT_ANY && !dest->stack->next) {
+        && dest->rule->first_suit == SUIT_ANY && !next_card(dest->stack)) {
       n++;
     }
   }
   return n;
 }
 
-int legal_move_stack(Pile *dest, Card *src, Pile *src_pile, Pile *piles) {
+static GameRule *get_move_rule(Pile *dest, Pile *src_pile, GameRule **valid_group_rule) {
   GameRule *rule = dest->rule;
-  GameRule *valid_group_rule = dest->rule;
-  if (get_bottom(src) == get_bottom(dest->stack)) {
-    return 0;
-  }
+  *valid_group_rule = dest->rule;
   if (rule->valid_group) {
-    valid_group_rule = rule->valid_group;
+    *valid_group_rule = rule->valid_group;
   }
   if (rule->class == src_pile->rule->class && rule->same_class) {
     rule = rule->same_class;
     if (rule->valid_group) {
-      valid_group_rule = rule->valid_group;
+      *valid_group_rule = rule->valid_group;
     }
   }
-  if (rule->from != RULE_ANY && rule->from != src_pile->rule->type) {
-    move_error = "Invalid destination";
+  return rule;
+}
+
+static int reject_move(char **error, char *message) {
+  if (error) {
+    *error = message;
+  }
+  return 0;
+}
+
+/* Checks whether the `count` cards starting at `src` may be placed on `top`,
+ * the top card of `dest`, without modifying anything. `top_up` overrides the
+ * face-up state of `top`, allowing callers to check a sequence of moves before
+ * performing any of them. */
+static int check_move(Pile *dest, Card *top, int top_up, Card *src, int count, Pile *src_pile, Pile *piles, char **error) {
+  GameRule *valid_group_rule;
+  GameRule *rule = get_move_rule(dest, src_pile, &valid_group_rule);
+  Card *next = count > 1 ? next_card(src) : NULL;
+  if (get_bottom(src) == get_bottom(dest->stack)) {
     return 0;
   }
-  if (rule->move_group == MOVE_ONE && src->next) {
+  if (rule->from != RULE_ANY && rule->from != src_pile->rule->type) {
+    return reject_move(error, "Invalid destination");
+  }
+  if (rule->move_group == MOVE_ONE && next) {
     int free_cells = count_free_cells(piles);
-    int required_cells;
-    Card *c;
     if (!free_cells) {
-      move_error = "Not allowed to move multiple cards";
-      return 0;
+      return reject_move(error, "Not allowed to move multiple cards");
     }
-    required_cells = 0;
-    for (c = src->next; c; c = c->next) {
-      required_cells++;
+    if (count - 1 > free_cells) {
+      return reject_move(error, "Not enough free cells");
     }
-    if (required_cells > free_cells) {
-      move_error = "Not enough free cells";
-      return 0;
-    }
-    if (!check_stack(src->next, rule->next_suit, rule->next_rank)) {
-      move_error = "Invalid sequence";
-      return 0;
+    if (!check_stack(next, rule)) {
+      return reject_move(error, "Invalid sequence");
     }
   }
-  if (rule->move_group == MOVE_GROUP && src->next && !check_stack(src->next, valid_group_rule->next_suit, valid_group_rule->next_rank)) {
-    move_error = "Invalid sequence";
-    return 0;
+  if (rule->move_group == MOVE_GROUP && next && !check_stack(next, valid_group_rule)) {
+    return reject_move(error, "Invalid sequence");
   }
   if (rule->move_group == MOVE_ALL) {
-    if (!check_stack(src->next, valid_group_rule->next_suit, valid_group_rule->next_rank)) {
-      move_error = "Invalid sequence";
-      return 0;
+    if (!check_stack(next, valid_group_rule)) {
+      return reject_move(error, "Invalid sequence");
     }
-    if (count_stack(src) != 13) {
-      move_error = "Invalid sequence";
-      return 0;
+    if (count != 13) {
+      return reject_move(error, "Invalid sequence");
     }
   }
-  if (dest->stack->next) {
-    Card *top = get_top(dest->stack);
-    if (!top->up) {
-      move_error = "Invalid destination";
-      return 0;
-    }
-    if (!check_next_suit(src, top, rule->next_suit) || !check_next_rank(src, top, rule->next_rank)) {
-      move_error = "Invalid sequence";
-      return 0;
+  if (NOT_BOTTOM(top)) {
+    if (!top_up) {
+      return reject_move(error, "Invalid destination");
     }
-    record_location(src);
-    top->next = src;
-    if (src->prev) {
-      src->prev->next = NULL;
+    if (!check_next(src, top, rule)) {
+      return reject_move(error, "Invalid sequence");
     }
-    src->prev = top;
-  } else {
-    if (!check_first_suit(src, rule->first_suit) || !check_first_rank(src, rule->first_rank)) {
-      move_error = "Invalid destination";
-      return 0;
-    }
-    record_location(src);
-    dest->stack->next = src;
-    if (src->prev){
-      src->prev->next = NULL;
-    }
-    src->prev = dest->stack;
+  } else if (!check_first(src, rule)) {
+    return reject_move(error, "Invalid destination");
   }
+  return 1;
+}
+
+int can_move_stack(Pile *dest, Card *src, Pile *src_pile, Pile *piles) {
+  Card *top = get_top(dest->stack);
+  return check_move(dest, top, top->up, src, count_stack(src), src_pile, piles, NULL);
+}
+
+/* Moves cards without checking the rules. If `combined` is set, the move is
+ * undone together with the previous move. */
+static void move_cards(GameState *state, Pile *dest, Card *src, Pile *src_pile, int combined) {
+  GameRule *valid_group_rule;
+  GameRule *rule = get_move_rule(dest, src_pile, &valid_group_rule);
+  record_location(state, src, combined);
+  hash_move_stack(state, dest->stack, src);
   if (rule->win_rank != RANK_NONE) {
     if (rule->win_rank == RANK_EMPTY) {
-      game_score -= 10;
+      state->score -= 10;
     } else {
-      game_score += 10;
+      state->score += 10;
     }
   }
   if (src_pile->rule->win_rank != RANK_NONE) {
     if (src_pile->rule->win_rank == RANK_EMPTY) {
-      game_score += 10;
+      state->score += 10;
     } else {
-      game_score -= 10;
+      state->score -= 10;
     }
   }
+}
+
+void apply_move(GameState *state, Pile *dest, Card *src, Pile *src_pile) {
+  move_cards(state, dest, src, src_pile, 0);
+}
+
+int legal_move_stack(GameState *state, Pile *dest, Card *src, Pile *src_pile) {
+  Card *top = get_top(dest->stack);
+  if (!check_move(dest, top, top->up, src, count_stack(src), src_pile, state->piles, &state->move_error)) {
+    return 0;
+  }
+  log_move(state, LOG_MOVE_STACK, src_pile->index, dest->index, src->index);
+  apply_move(state, dest, src, src_pile);
   return 1;
 }
 
-int turn_from_stock(Card *card, Pile *stock, Pile *piles) {
+/* Returns the number of cards that turning `card` from the stock would move,
+ * or 0 if any of them would be rejected by its destination. Each pass over
+ * the destinations moves one card to each of them, so card i lands on top of
+ * card i - dests. */
+static int check_turn_from_stock(Card *card, Pile *stock, Pile *piles, char **error) {
+  Card **cards = stock->stack->stack->cards;
+  int available = card->index;
+  int dests = 0;
   int turns = 0;
   Pile *dest;
-  while (turns < stock->rule->turn) {
-    if (IS_BOTTOM(card)) {
-      break;
+  for (dest = piles; dest; dest = dest->next) {
+    if (dest->rule->type == stock->rule->to) {
+      dests++;
     }
-    for (dest = piles; dest; dest = dest->next) {
+  }
+  if (!dests) {
+    return 0;
+  }
+  while (turns < stock->rule->turn && turns < available) {
+    for (dest = piles; dest && turns < available; dest = dest->next) {
       if (dest->rule->type == stock->rule->to) {
-        if (legal_move_stack(dest, card, stock, piles)) {
-          if (turns) {
-            combine_undo_moves();
-          }
-          card->up = 1;
-          turns++;
-          card = get_top(stock->stack);
+        Card *src = cards[card->index - turns];
+        int ok;
+        if (turns >= dests) {
+          ok = check_move(dest, cards[card->index - turns + dests], 1, src, 1, stock, piles, error);
         } else {
-          if (turns > 0) {
-            undo_move();
-          }
-          clear_redo_history();
+          Card *top = get_top(dest->stack);
+          ok = check_move(dest, top, top->up, src, 1, stock, piles, error);
+        }
+        if (!ok) {
           return 0;
         }
+        turns++;
+      }
+    }
+  }
+  return turns;
+}
+
+/* Cards are always taken from the top of the stock, so `card` must be the
+ * top card for check_turn_from_stock to check the cards that are moved */
+int turn_from_stock(GameState *state, Card *card, Pile *stock) {
+  int turns;
+  int i = 0;
+  Pile *dest;
+  assert(card == get_top(stock->stack));
+  turns = check_turn_from_stock(card, stock, state->piles, &state->move_error);
+  if (turns) {
+    log_move(state, LOG_TURN_STOCK, stock->index, 0, card->index);
+  }
+  while (i < turns) {
+    for (dest = state->piles; dest && i < turns; dest = dest->next) {
+      if (dest->rule->type == stock->rule->to) {
+        card = get_top(stock->stack);
+        move_cards(state, dest, card, stock, i > 0);
+        hash_set_up(state, card, 1);
+        i++;
       }
     }
   }
   return turns > 0;
 }
 
-int redeal(Pile *stock, Pile *piles) {
+int redeal(GameState *state, Pile *stock) {
   if (stock->rule->redeals < 0 || stock->redeals < stock->rule->redeals) {
     Pile *src;
-    stock->redeals++;
-    for (src = piles; src; src = src->next) {
+    for (src = state->piles; src; src = src->next) {
       if (src->rule->type == RULE_WASTE) {
         Card *src_card;
-        record_redeal(stock, src);
+        hash_set_redeals(state, stock, stock->redeals + 1);
+        log_move(state, LOG_REDEAL, stock->index, 0, 0);
+        record_redeal(state, stock, src);
         src_card = get_top(src->stack);
         while (!(src_card->suit & BOTTOM)) {
-          Card *prev = src_card->prev;
-          move_stack(stock->stack, src_card);
+          Card *prev = prev_card(src_card);
+          hash_set_up(state, src_card, 0);
+          hash_move_stack(state, stock->stack, src_card);
           src_card = prev;
         }
-        game_score -= 50;
+        state->score -= 50;
         return 1;
       }
     }
   }
-  move_error = "No more redeals";
+  state->move_error = "No more redeals";
   return 0;
 }
 
-int move_to_foundation(Card *src, Pile *src_pile, Pile *piles) {
+int move_to_foundation(GameState *state, Card *src, Pile *src_pile) {
   Pile *dest;
-  for (dest = piles; dest; dest = dest->next) {
+  for (dest = state->piles; dest; dest = dest->next) {
     if (dest->rule->type == RULE_FOUNDATION) {
-      if (legal_move_stack(dest, src, src_pile, piles)) {
+      if (legal_move_stack(state, dest, src, src_pile)) {
         return 1;
       }
     }
@@ -653,11 +1213,11 @@ int move_to_foundation(Card *src, Pile *src_pile, Pile *piles) {
   return 0;
 }
 
-int move_to_free_cell(Card *src, Pile *src_pile, Pile *piles) {
+int move_to_free_cell(GameState *state, Card *src, Pile *src_pile) {
   Pile *dest;
-  for (dest = piles; dest; dest = dest->next) {
+  for (dest = state->piles; dest; dest = dest->next) {
     if (dest->rule->type == RULE_CELL) {
-      if (legal_move_stack(dest, src, src_pile, piles)) {
+      if (legal_move_stack(state, dest, src, src_pile)) {
         return 1;
       }
     }
@@ -665,29 +1225,29 @@ int move_to_free_cell(Card *src, Pile *src_pile, Pile *piles) {
   return 0;
 }
 
-int auto_move_to_foundation(Pile *piles) {
+int auto_move_to_foundation(GameState *state) {
   Pile *src;
-  for (src = piles; src; src = src->next) {
+  for (src = state->piles; src; src = src->next) {
     if (src->rule->type != RULE_FOUNDATION && src->rule->type != RULE_STOCK) {
       Card *src_card = get_top(src->stack);
       if (!(src_card->suit & BOTTOM)) {
-        if (turn_card(src_card)) {
+        if (turn_card(state, src_card)) {
           return 1;
         } else {
           Pile *dest;
-          for (dest = piles; dest; dest = dest->next) {
+          for (dest = state->piles; dest; dest = dest->next) {
             if (dest->rule->type == RULE_FOUNDATION) {
               if (dest->rule->move_group == MOVE_ONE) {
-                if (legal_move_stack(dest, src_card, src, piles)) {
+                if (legal_move_stack(state, dest, src_card, src)) {
                   return 1;
                 }
               } else {
                 Card *c = src_card;
                 while (c && !IS_BOTTOM(c) && c->up) {
-                  if (legal_move_stack(dest, c, src, piles)) {
+                  if (legal_move_stack(state, dest, c, src)) {
                     return 1;
                   }
-                  c = c->prev;
+                  c = prev_card(c);
                 }
               }
             }
@@ -699,11 +1259,12 @@ int auto_move_to_foundation(Pile *piles) {
   return 0;
 }
 
-int turn_card(Card *card) {
-  if (!card->next && !card->up) {
-    game_score += 5;
-    record_turn(card);
-    card->up = 1;
+int turn_card(GameState *state, Card *card) {
+  if (!next_card(card) && !card->up) {
+    state->score += 5;
+    log_move(state, LOG_TURN_CARD, card->stack->id, 0, card->index);
+    record_turn(state, card, 0);
+    hash_set_up(state, card, 1);
     return 1;
   }
   return 0;
@@ -721,3 +1282,152 @@ int check_win_condition(Pile *piles) {
   }
   return 1;
 }
+
+Pile *get_pile(Pile *piles, int index) {
+  while (piles && piles->index != index) {
+    piles = piles->next;
+  }
+  return piles;
+}
+
+MoveList *new_move_list() {
+  MoveList *list = malloc(sizeof(MoveList));
+  list->size = 0;
+  list->capacity = 64;
+  list->moves = malloc(list->capacity * sizeof(Move));
+  return list;
+}
+
+void delete_move_list(MoveList *list) {
+  free(list->moves);
+  free(list);
+}
+
+static void add_move(MoveList *list, MoveType type, Pile *src, Pile *dest, int count) {
+  Move *move;
+  if (list->size >= list->capacity) {
+    list->capacity *= 2;
+    list->moves = realloc(list->moves, list->capacity * sizeof(Move));
+  }
+  move = &list->moves[list->size++];
+  move->type = type;
+  move->src = src->index;
+  move->dest = dest->index;
+  move->count = count;
+}
+
+static int can_redeal(Pile *stock, Pile *piles) {
+  Pile *waste;
+  if (stock->rule->redeals >= 0 && stock->redeals >= stock->rule->redeals) {
+    return 0;
+  }
+  for (waste = piles; waste; waste = waste->next) {
+    if (waste->rule->type == RULE_WASTE) {
+      return next_card(waste->stack) != NULL;
+    }
+  }
+  return 0;
+}
+
+/* A cheap necessary condition for can_move_stack: whether `dest` accepts
+ * `card` on its current top card. */
+static int accepts_card(Pile *dest, Card *card, Pile *src_pile) {
+  GameRule *valid_group_rule;
+  GameRule *rule = get_move_rule(dest, src_pile, &valid_group_rule);
+  Card *top = get_top(dest->stack);
+  if (NOT_BOTTOM(top)) {
+    return top->up && check_next(card, top, rule);
+  }
+  return check_first(card, rule);
+}
+
+/* Lists every move that a player can make in the current position, except
+ * redeals of an empty waste pile. Stacks of cards can only be picked up from
+ * tableaus, from other piles only the top card can be moved. */
+int generate_moves(Pile *piles, MoveList *list) {
+  Pile *src, *dest;
+  list->size = 0;
+  for (src = piles; src; src = src->next) {
+    Card *top = get_top(src->stack);
+    if (src->rule->type == RULE_STOCK) {
+      if (NOT_BOTTOM(top)) {
+        if (check_turn_from_stock(top, src, piles, NULL)) {
+          add_move(list, MOVE_TURN_STOCK, src, src, 0);
+        }
+      } else if (can_redeal(src, piles)) {
+        add_move(list, MOVE_REDEAL, src, src, 0);
+      }
+    } else if (NOT_BOTTOM(top) && !top->up) {
+      add_move(list, MOVE_TURN_CARD, src, src, 1);
+    } else {
+      Card *card;
+      int count = 1;
+      int max_count = src->stack->suit == TABLEAU ? INT_MAX : 1;
+      for (card = top; NOT_BOTTOM(card) && card->up && count <= max_count;
+          card = prev_card(card), count++) {
+        for (dest = piles; dest; dest = dest->next) {
+          if (dest != src && accepts_card(dest, card, src) && can_move_stack(dest, card, src, piles)) {
+            add_move(list, MOVE_STACK, src, dest, count);
+          }
+        }
+      }
+    }
+  }
+  return list->size;
+}
+
+int play_move(GameState *state, Move move) {
+  Pile *src = get_pile(state->piles, move.src);
+  Stack *stack = src->stack->stack;
+  switch (move.type) {
+    case MOVE_STACK:
+      return legal_move_stack(state, get_pile(state->piles, move.dest), stack->cards[stack->size - move.count], src);
+    case MOVE_TURN_CARD:
+      return turn_card(state, get_top(src->stack));
+    case MOVE_TURN_STOCK:
+      return turn_from_stock(state, get_top(src->stack), src);
+    case MOVE_REDEAL:
+      return redeal(state, src);
+    default:
+      return 0;
+  }
+}
+
+/* Makes the move described by an entry in the move log. Returns 0 if the
+ * entry doesn't describe a valid move. */
+int replay_record(GameState *state, LogRecord record) {
+  Pile *src = get_pile(state->piles, LOG_SRC(record));
+  Stack *stack;
+  int index = LOG_INDEX(record);
+  if (LOG_TYPE(record) == LOG_UNDO) {
+    return undo_move(state);
+  } else if (LOG_TYPE(record) == LOG_REDO) {
+    return redo_move(state);
+  } else if (!src) {
+    return 0;
+  }
+  stack = src->stack->stack;
+  switch (LOG_TYPE(record)) {
+    case LOG_MOVE_STACK: {
+      Pile *dest = get_pile(state->piles, LOG_DEST(record));
+      if (!dest || index < 1 || index >= stack->size) {
+        return 0;
+      }
+      return legal_move_stack(state, dest, stack->cards[index], src);
+    }
+    case LOG_TURN_CARD:
+      if (index < 1 || index != stack->size - 1) {
+        return 0;
+      }
+      return turn_card(state, stack->cards[index]);
+    case LOG_TURN_STOCK:
+      if (index < 1 || index != stack->size - 1) {
+        return 0;
+      }
+      return turn_from_stock(state, stack->cards[index], src);
+    case LOG_REDEAL:
+      return redeal(state, src);
+    default:
+      return 0;
+  }
+}
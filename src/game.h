@@ -10,11 +10,17 @@
 #include "card.h"
 
 #include <inttypes.h>
+#include <stddef.h>
 
 typedef struct pile Pile;
 typedef struct game_list GameList;
 typedef struct game Game;
 typedef struct game_rule GameRule;
+typedef struct rule_table RuleTable;
+typedef struct move Move;
+typedef struct move_list MoveList;
+typedef struct game_state GameState;
+typedef struct snapshot Snapshot;
 typedef enum {
   RULE_NONE,
   RULE_ANY,
@@ -68,6 +74,12 @@ typedef enum {
   MOVE_ONE,
   MOVE_ALL
 } GameRuleMove;
+typedef enum {
+  MOVE_STACK,
+  MOVE_TURN_CARD,
+  MOVE_TURN_STOCK,
+  MOVE_REDEAL
+} MoveType;
 
 struct game_list {
   Game *game;
@@ -103,6 +115,10 @@ struct game_rule {
   short turn;
   GameRule *same_class;
   GameRule *valid_group;
+  /* Compiled by register_game: the cards accepted by an empty pile (one bit
+   * per card id), and the table of cards allowed on top of each card. */
+  uint32_t first_cards[2];
+  RuleTable *next_cards;
 };
 
 struct pile {
@@ -110,10 +126,105 @@ struct pile {
   Card *stack;
   GameRule *rule;
   int redeals;
+  int index;
+};
+
+/* Entries in the move log are packed into 32 bits: the type in the lowest 4
+ * bits followed by the source pile, the destination pile and the index of the
+ * first card moved or turned in the source pile. */
+typedef uint32_t LogRecord;
+
+typedef enum {
+  LOG_MOVE_STACK,
+  LOG_TURN_CARD,
+  LOG_TURN_STOCK,
+  LOG_REDEAL,
+  LOG_UNDO,
+  LOG_REDO
+} LogType;
+
+#define LOG_RECORD(type, src, dest, index) ((LogRecord)(type) | (LogRecord)(src) << 4\
+    | (LogRecord)(dest) << 12 | (LogRecord)(index) << 20)
+#define LOG_TYPE(record) ((record) & 0xF)
+#define LOG_SRC(record) ((record) >> 4 & 0xFF)
+#define LOG_DEST(record) ((record) >> 12 & 0xFF)
+#define LOG_INDEX(record) ((record) >> 20)
+
+/* A move that can be passed to play_move. Piles are referred to by their
+ * index, `count` is the number of cards moved from the top of the source. */
+struct move {
+  unsigned char type;
+  unsigned char src;
+  unsigned char dest;
+  short count;
 };
 
-extern int move_counter;
-extern int32_t game_score;
+struct move_list {
+  Move *moves;
+  int size;
+  int capacity;
+};
+
+/* Initial block size of the arena used for a single deal */
+#define DEAL_ARENA_SIZE 16384
+
+/* A game in progress: the dealt piles and everything that changes as moves
+ * are made. All functions that make moves update the state they are given,
+ * so several games can be played at once. */
+struct game_state {
+  Pile *piles;
+  int move_counter;
+  int32_t score;
+  /* Zobrist hash of the current position, kept up to date by every function
+   * that moves, turns or redeals cards */
+  uint64_t hash;
+  char *move_error;
+  /* The piles and cards, allocated as a single block */
+  void *board;
+  size_t board_size;
+  int pile_count;
+  int deck_size;
+  /* One flag per pile index, set whenever the cards of the pile are moved,
+   * turned or redealt. Cleared by the user interface once it has redrawn
+   * the piles. */
+  unsigned char *damage;
+  /* The arena that the state, board and undo history are allocated from */
+  Arena *arena;
+  /* The undo history is a ring buffer of records. Positions only ever grow
+   * and are mapped onto the buffer, which holds the records from
+   * `history_start` to `undo_end` that can be undone followed by the ones up
+   * to `redo_end` that can be redone. */
+  struct record *history;
+  int history_capacity;
+  unsigned long history_start;
+  unsigned long undo_end;
+  unsigned long redo_end;
+  /* Number of moves that can be undone */
+  int undo_length;
+  /* Maximum number of moves kept in the undo history, 0 for no limit */
+  int undo_limit;
+  /* Incremented for every record, used to tell whether a snapshot's undo
+   * history is still intact */
+  unsigned long serial;
+  /* Every move, undo and redo that has been made, recorded when
+   * `log_moves` is set */
+  int log_moves;
+  LogRecord *log;
+  int log_size;
+  int log_capacity;
+};
+
+/* A copy of the board and counters of a GameState */
+struct snapshot {
+  void *board;
+  int move_counter;
+  int32_t score;
+  uint64_t hash;
+  unsigned long undo_end;
+  /* Serial number of the last record in the undo history */
+  unsigned long serial;
+  int log_size;
+};
 
 Game *new_game();
 GameRule *new_game_rule(GameRuleType type);
@@ -122,20 +233,37 @@ void register_game_dir(const char *cwd, const char *dir);
 void load_game_dirs();
 GameList *list_games();
 Game *get_game(const char *name);
-Pile *deal_cards(Game *game, Card *deck);
-void delete_piles(Pile *piles);
-int legal_move_stack(Pile *dest, Card *src, Pile *src_pile, Pile *pile);
-int turn_from_stock(Card *card, Pile *stock, Pile *piles);
-int redeal(Pile *stock, Pile *piles);
-int move_to_foundation(Card *src, Pile *src_pile, Pile *piles);
-int move_to_free_cell(Card *src, Pile *src_pile, Pile *piles);
-int auto_move_to_foundation(Pile *piles);
-int turn_card(Card *card);
+GameState *new_game_state(Arena *arena, Game *game, Card *deck);
+Snapshot *new_snapshot(GameState *state);
+void delete_snapshot(Snapshot *snapshot);
+void state_snapshot(GameState *state, Snapshot *snapshot);
+void state_restore(GameState *state, Snapshot *snapshot);
+unsigned char *serialize_game_state(GameState *state, int history_limit, size_t *size);
+GameState *deserialize_game_state(Arena *arena, Game *game, const unsigned char *data, size_t size);
+int check_next(Card *card, Card *previous, GameRule *rule);
+int can_move_stack(Pile *dest, Card *src, Pile *src_pile, Pile *piles);
+void apply_move(GameState *state, Pile *dest, Card *src, Pile *src_pile);
+int legal_move_stack(GameState *state, Pile *dest, Card *src, Pile *src_pile);
+int turn_from_stock(GameState *state, Card *card, Pile *stock);
+int redeal(GameState *state, Pile *stock);
+int move_to_foundation(GameState *state, Card *src, Pile *src_pile);
+int move_to_free_cell(GameState *state, Card *src, Pile *src_pile);
+int auto_move_to_foundation(GameState *state);
+int turn_card(GameState *state, Card *card);
 int check_win_condition(Pile *piles);
+uint64_t hash_piles(Pile *piles);
+
+Pile *get_pile(Pile *piles, int index);
+MoveList *new_move_list();
+void delete_move_list(MoveList *list);
+int generate_moves(Pile *piles, MoveList *list);
+int play_move(GameState *state, Move move);
 
-char *get_move_error();
-void clear_undo_history();
-int undo_move();
-int redo_move();
+char *get_move_error(GameState *state);
+void clear_redo_history(GameState *state);
+void clear_undo_history(GameState *state);
+int undo_move(GameState *state);
+int redo_move(GameState *state);
+int replay_record(GameState *state, LogRecord record);
 
 #endif
@@ -0,0 +1,172 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#include "grid.h"
+
+#include "render.h"
+
+#include <stdlib.h>
+
+static const GridCell empty_cell = {NULL, NULL, NULL, NULL, NULL, NULL};
+
+Grid *new_grid() {
+  Grid *grid = malloc(sizeof(Grid));
+  grid->max_x = 0;
+  grid->max_y = 0;
+  grid->width = 0;
+  grid->height = 0;
+  grid->cells = NULL;
+  grid->cell_capacity = 0;
+  grid->first = NULL;
+  grid->last = NULL;
+  grid->row_capacity = 0;
+  return grid;
+}
+
+void delete_grid(Grid *grid) {
+  free(grid->cells);
+  free(grid->first);
+  free(grid->last);
+  free(grid);
+}
+
+/* Face down cards can only be moved to when they are at the top of their
+ * pile */
+static int is_reachable(Card *card) {
+  return card && (card->up || !next_card(card));
+}
+
+static GridCell *cell_at(Grid *grid, int x, int y) {
+  return grid->cells + (y + 1) * grid->width + x + 1;
+}
+
+static void resize_grid(Grid *grid) {
+  int i;
+  grid->width = grid->max_x + 3;
+  grid->height = grid->max_y + 3;
+  if (grid->width * grid->height > grid->cell_capacity) {
+    grid->cell_capacity = grid->width * grid->height;
+    grid->cells = realloc(grid->cells, grid->cell_capacity * sizeof(GridCell));
+  }
+  if (grid->height > grid->row_capacity) {
+    grid->row_capacity = grid->height;
+    grid->first = realloc(grid->first, grid->row_capacity * sizeof(Card *));
+    grid->last = realloc(grid->last, grid->row_capacity * sizeof(Card *));
+  }
+  for (i = 0; i < grid->width * grid->height; i++) {
+    grid->cells[i] = empty_cell;
+  }
+}
+
+/* Finds the cards next to each cell, column by column and row by row */
+static void link_cells(Grid *grid) {
+  int x, y;
+  for (x = -1; x <= grid->max_x + 1; x++) {
+    Card *north = NULL, *south = NULL;
+    for (y = -1; y <= grid->max_y + 1; y++) {
+      GridCell *cell = cell_at(grid, x, y);
+      cell->north = north;
+      if (is_reachable(cell->card) && cell_at(grid, x, y + 1)->card != cell->card) {
+        north = cell->card;
+      }
+    }
+    for (y = grid->max_y + 1; y >= -1; y--) {
+      GridCell *cell = cell_at(grid, x, y);
+      cell->south = south;
+      if (is_reachable(cell->card) && cell->card->y == y) {
+        south = cell->card;
+      }
+    }
+  }
+  for (y = -1; y <= grid->max_y + 1; y++) {
+    Card *west = NULL, *east = NULL;
+    for (x = -1; x <= grid->max_x + 1; x++) {
+      GridCell *cell = cell_at(grid, x, y);
+      cell->west = west;
+      if (is_reachable(cell->card)) {
+        west = cell->card;
+      }
+    }
+    grid->last[y + 1] = west;
+    for (x = grid->max_x + 1; x >= -1; x--) {
+      GridCell *cell = cell_at(grid, x, y);
+      cell->east = east;
+      if (is_reachable(cell->card)) {
+        east = cell->card;
+      }
+    }
+    grid->first[y + 1] = east;
+  }
+}
+
+void build_grid(Grid *grid, Pile *piles, Theme *theme) {
+  Pile *pile;
+  Card *card, *top;
+  int y;
+  grid->max_x = 0;
+  grid->max_y = 0;
+  for (pile = piles; pile; pile = pile->next) {
+    top = get_top(pile->stack);
+    if (top->x > grid->max_x) {
+      grid->max_x = top->x;
+    }
+    if (top->y + theme->height - 1 > grid->max_y) {
+      grid->max_y = top->y + theme->height - 1;
+    }
+  }
+  resize_grid(grid);
+  for (pile = piles; pile; pile = pile->next) {
+    if (pile->rule->type != RULE_STOCK && pile->stack->suit == TABLEAU) {
+      for (y = get_first_shown(pile)->y; y <= grid->max_y + 1; y++) {
+        cell_at(grid, pile->rule->x, y)->pile = pile;
+      }
+    }
+  }
+  for (pile = piles; pile; pile = pile->next) {
+    top = get_top(pile->stack);
+    for (card = get_first_shown(pile); card; card = next_card(card)) {
+      int bottom = card == top ? card->y + theme->height - 1 : card->y;
+      for (y = card->y; y <= bottom; y++) {
+        GridCell *cell = cell_at(grid, card->x, y);
+        cell->card = card;
+        cell->pile = pile;
+      }
+    }
+  }
+  link_cells(grid);
+}
+
+static int clamp(int value, int min, int max) {
+  return value < min ? min : value > max ? max : value;
+}
+
+GridCell *get_grid_cell(Grid *grid, int x, int y) {
+  return cell_at(grid, clamp(x, -1, grid->max_x + 1), clamp(y, -1, grid->max_y + 1));
+}
+
+GridCell *find_grid_cell(Grid *grid, Theme *theme, int off_y, int screen_y, int screen_x, int *x, int *y) {
+  int column_width = theme->width + theme->x_spacing;
+  int column_x = screen_x - theme_x(0, theme);
+  GridCell *cell;
+  if (column_x < 0 || column_x % column_width >= theme->width) {
+    return NULL;
+  }
+  *x = column_x / column_width;
+  *y = screen_y - theme_y(0, theme, off_y);
+  if (*x > grid->max_x || *y < 0 || *y > grid->max_y) {
+    return NULL;
+  }
+  cell = cell_at(grid, *x, *y);
+  return cell->card || cell->pile ? cell : NULL;
+}
+
+Card *get_leftmost(Grid *grid, int y) {
+  return grid->first[clamp(y, -1, grid->max_y + 1) + 1];
+}
+
+Card *get_rightmost(Grid *grid, int y) {
+  return grid->last[clamp(y, -1, grid->max_y + 1) + 1];
+}
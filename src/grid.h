@@ -0,0 +1,65 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#ifndef GRID_H
+#define GRID_H
+
+#include "card.h"
+#include "game.h"
+#include "theme.h"
+
+typedef struct grid Grid;
+typedef struct grid_cell GridCell;
+
+/* A position on the board, see layout_piles */
+struct grid_cell {
+  /* The card shown at the position and its pile. Below the first card of a
+   * tableau `pile` is the tableau even where it has no cards. */
+  Card *card;
+  Pile *pile;
+  /* The nearest cards the cursor can move to in each direction. A card is
+   * north of the position if it ends above it and south of it if it starts
+   * below it, in the same column. A card is west or east of the position if
+   * it covers the same row. */
+  Card *north;
+  Card *south;
+  Card *west;
+  Card *east;
+};
+
+/* An index of the cards on the board by position. It is built from the
+ * layout so that the cards at and around a position are found without
+ * visiting the piles. */
+struct grid {
+  /* The largest column and row covered by a card */
+  int max_x;
+  int max_y;
+  /* Cells of columns -1 to max_x + 1 and rows -1 to max_y + 1 */
+  int width;
+  int height;
+  GridCell *cells;
+  int cell_capacity;
+  /* The leftmost and rightmost card the cursor can move to in each row */
+  Card **first;
+  Card **last;
+  int row_capacity;
+};
+
+Grid *new_grid();
+void delete_grid(Grid *grid);
+/* Indexes the piles as laid out by layout_piles */
+void build_grid(Grid *grid, Pile *piles, Theme *theme);
+/* Positions outside the board are moved to the nearest empty column or row
+ * next to it */
+GridCell *get_grid_cell(Grid *grid, int x, int y);
+/* Finds the card or pile at a position on the screen as drawn by draw_piles
+ * and stores its column and row in `x` and `y`. Returns NULL if there is no
+ * card or pile at the position. */
+GridCell *find_grid_cell(Grid *grid, Theme *theme, int off_y, int screen_y, int screen_x, int *x, int *y);
+Card *get_leftmost(Grid *grid, int y);
+Card *get_rightmost(Grid *grid, int y);
+
+#endif
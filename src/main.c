@@ -14,6 +14,11 @@
 #include "util.h"
 #include "scores.h"
 #include "color.h"
+#include "solver.h"
+#include "survey.h"
+#include "perft.h"
+#include "replay.h"
+#include "save.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -26,7 +31,7 @@
 #include <errno.h>
 #include <time.h>
 
-const char *short_options = "?hvlt:Tms:c:CS";
+const char *short_options = "?hvlt:Tms:c:CSxn:M:ye:j:o:r:HD:pN:fd:";
 
 #ifdef USE_GETOPT
 const struct option long_options[] = {
@@ -40,11 +45,25 @@ const struct option long_options[] = {
   {"config", required_argument, NULL, 'c'},
   {"colors", no_argument, NULL, 'C'},
   {"scores", no_argument, NULL, 'S'},
+  {"solve", no_argument, NULL, 'x'},
+  {"nodes", required_argument, NULL, 'n'},
+  {"memory", required_argument, NULL, 'M'},
+  {"survey", no_argument, NULL, 'y'},
+  {"seeds", required_argument, NULL, 'e'},
+  {"threads", required_argument, NULL, 'j'},
+  {"output", required_argument, NULL, 'o'},
+  {"replay", required_argument, NULL, 'r'},
+  {"headless", no_argument, NULL, 'H'},
+  {"delay", required_argument, NULL, 'D'},
+  {"playouts", no_argument, NULL, 'p'},
+  {"count", required_argument, NULL, 'N'},
+  {"perft", no_argument, NULL, 'f'},
+  {"depth", required_argument, NULL, 'd'},
   {0, 0, 0, 0}
 };
 #endif
 
-enum action { PLAY, LIST_GAMES, LIST_THEMES, LIST_COLORS, SHOW_SCORES };
+enum action { PLAY, LIST_GAMES, LIST_THEMES, LIST_COLORS, SHOW_SCORES, SOLVE, SURVEY, REPLAY, PLAYOUTS, PERFT };
 
 static void describe_option(const char *short_option, const char *long_option, const char *description) {
 #ifdef USE_GETOPT
@@ -54,6 +73,56 @@ static void describe_option(const char *short_option, const char *long_option, c
 #endif
 }
 
+static void describe_usage(const char *arg0) {
+  printf("usage: %s [options] [game]\n", arg0);
+  puts("options:");
+  describe_option("h", "help", "Show help.");
+  describe_option("v", "version", "Show version information.");
+  describe_option("l", "list", "List available games.");
+  describe_option("t <name>", "theme <name>", "Select a theme.");
+  describe_option("T", "themes", "List available themes.");
+  describe_option("m", "mono", "Disable colors.");
+  describe_option("s <seed>", "seed <seed>", "Select seed.");
+  describe_option("c <file>", "config <file>", "Select configuration file.");
+  describe_option("C", "colors", "List colors");
+  describe_option("S", "scores", "List scores");
+  describe_option("x", "solve", "Solve the selected seed.");
+  describe_option("n <nodes>", "nodes <nodes>", "Solver node limit.");
+  describe_option("M <MiB>", "memory <MiB>", "Solver memory limit.");
+  describe_option("y", "survey", "Solve a range of seeds.");
+  describe_option("e <a-b>", "seeds <a-b>", "Select seeds for survey.");
+  describe_option("j <n>", "threads <n>", "Number of parallel workers.");
+  describe_option("o <file>", "output <file>", "Write survey results to file.");
+  describe_option("r <file>", "replay <file>", "Replay a recorded game.");
+  describe_option("H", "headless", "Replay without user interface.");
+  describe_option("D <ms>", "delay <ms>", "Delay between replayed moves.");
+  describe_option("p", "playouts", "Play seeds with random moves.");
+  describe_option("N <n>", "count <n>", "Number of seeds for playouts.");
+  describe_option("f", "perft", "Count move sequences from a seed.");
+  describe_option("d <n>", "depth <n>", "Number of moves for perft.");
+  puts("keys:");
+  printf("  %-15s %s\n", "Arrow keys", "Move cursor");
+  printf("  %-15s %s\n", "hjkl", "Move cursor");
+  printf("  %-15s %s\n", "Space", "Select card");
+  printf("  %-15s %s\n", "Enter", "Move card");
+  printf("  %-15s %s\n", "F10", "Open menu");
+  printf("  %-15s %s\n", "q", "Quit");
+}
+
+/* Parses a seed range of the form "a-b" or a single seed "a" */
+static int parse_seeds(const char *arg, unsigned int *first_seed, unsigned int *last_seed) {
+  int end = 0;
+  if (sscanf(arg, "%u-%u%n", first_seed, last_seed, &end) == 2 && !arg[end]) {
+    return 1;
+  }
+  end = 0;
+  if (sscanf(arg, "%u%n", first_seed, &end) == 1 && !arg[end]) {
+    *last_seed = *first_seed;
+    return 1;
+  }
+  return 0;
+}
+
 static char *find_csolrc() {
   FILE *f;
 #ifdef USE_XDG_PATHS
@@ -89,12 +158,23 @@ static char *find_csolrc() {
 }
 
 int main(int argc, char *argv[]) {
-  int opt, rc_opt, error;
+  int opt, rc_opt, error, batch;
 #ifdef USE_GETOPT
   int option_index = 0;
 #endif
   int colors = 1;
   unsigned int seed = time(NULL);
+  long max_nodes = 1000000;
+  long max_memory = 64;
+  unsigned int first_seed = 1, last_seed = 1000;
+  long count = 0;
+  int depth = 3;
+  int workers = 0;
+  char *output = NULL;
+  char *replay_file = NULL;
+  Replay *replay = NULL;
+  int headless = 0;
+  int delay = 250;
   enum action action = PLAY;
   char *rc_file = NULL;
   char *game_name = NULL;
@@ -111,25 +191,7 @@ int main(int argc, char *argv[]) {
     switch (opt) {
       case '?':
       case 'h':
-        printf("usage: %s [options] [game]\n", argv[0]);
-        puts("options:");
-        describe_option("h", "help", "Show help.");
-        describe_option("v", "version", "Show version information.");
-        describe_option("l", "list", "List available games.");
-        describe_option("t <name>", "theme <name>", "Select a theme.");
-        describe_option("T", "themes", "List available themes.");
-        describe_option("m", "mono", "Disable colors.");
-        describe_option("s <seed>", "seed <seed>", "Select seed.");
-        describe_option("c <file>", "config <file>", "Select configuration file.");
-        describe_option("C", "colors", "List colors");
-        describe_option("S", "scores", "List scores");
-        puts("keys:");
-        printf("  %-15s %s\n", "Arrow keys", "Move cursor");
-        printf("  %-15s %s\n", "hjkl", "Move cursor");
-        printf("  %-15s %s\n", "Space", "Select card");
-        printf("  %-15s %s\n", "Enter", "Move card");
-        printf("  %-15s %s\n", "F10", "Open menu");
-        printf("  %-15s %s\n", "q", "Quit");
+        describe_usage(argv[0]);
         return 0;
       case 'v':
         puts("csol " CSOL_VERSION);
@@ -158,12 +220,62 @@ int main(int argc, char *argv[]) {
       case 'S':
         action = SHOW_SCORES;
         break;
+      case 'x':
+        action = SOLVE;
+        break;
+      case 'n':
+        max_nodes = atol(optarg);
+        break;
+      case 'M':
+        max_memory = atol(optarg);
+        break;
+      case 'y':
+        action = SURVEY;
+        break;
+      case 'e':
+        if (!parse_seeds(optarg, &first_seed, &last_seed)) {
+          printf("invalid seed range: '%s'\n", optarg);
+          describe_usage(argv[0]);
+          return 1;
+        }
+        break;
+      case 'j':
+        workers = atoi(optarg);
+        break;
+      case 'o':
+        output = optarg;
+        break;
+      case 'r':
+        replay_file = optarg;
+        break;
+      case 'H':
+        headless = 1;
+        break;
+      case 'D':
+        delay = atoi(optarg);
+        break;
+      case 'p':
+        action = PLAYOUTS;
+        break;
+      case 'N':
+        count = atol(optarg);
+        break;
+      case 'f':
+        action = PERFT;
+        break;
+      case 'd':
+        depth = atoi(optarg);
+        break;
 
     }
   }
   if (optind < argc) {
     game_name = argv[optind];
   }
+  /* Modes whose output may be piped to other programs and that don't wait for
+   * the user */
+  batch = action == SOLVE || action == SURVEY || action == PLAYOUTS || action == PERFT
+    || (replay_file && headless);
   rc_opt = 1;
   error = 0;
   if (!rc_file) {
@@ -175,7 +287,7 @@ int main(int argc, char *argv[]) {
     }
   }
   if (!error) {
-    printf("Using configuration file: %s\n", rc_file);
+    fprintf(batch ? stderr : stdout, "Using configuration file: %s\n", rc_file);
     error = !execute_file(rc_file);
     if (!rc_opt) {
       free(rc_file);
@@ -187,10 +299,29 @@ int main(int argc, char *argv[]) {
   if (!touch_stats_file(argv[0])) {
     error = 1;
   }
-  if (error) {
+  if (!touch_replay_dir(argv[0])) {
+    error = 1;
+  }
+  if (!touch_save_dir(argv[0])) {
+    error = 1;
+  }
+  if (error && batch) {
+    fprintf(stderr, "Configuration errors detected\n");
+  } else if (error) {
     printf("Configuration errors detected, press enter to continue\n");
     getchar();
   }
+  if (replay_file) {
+    replay = load_replay(replay_file);
+    if (!replay) {
+      return 1;
+    }
+    game_name = replay->game;
+    seed = replay->seed;
+    if (headless) {
+      action = REPLAY;
+    }
+  }
   switch (action) {
     case LIST_GAMES: {
       GameList *list;
@@ -286,8 +417,89 @@ int main(int argc, char *argv[]) {
         printf("game not found: '%s'\n", game_name);
         return 1;
       }
-      ui_main(game, theme, colors, seed);
+      ui_main(game, theme, colors, seed, replay, delay);
       break;
+    case SOLVE:
+    case SURVEY:
+    case REPLAY:
+    case PERFT:
+      if (game_name == NULL) {
+        game_name = get_property("default_game");
+        if (game_name == NULL) {
+          printf("default_game not set\n");
+          return 1;
+        }
+      }
+      game = get_game(game_name);
+      if (!game) {
+        printf("game not found: '%s'\n", game_name);
+        return 1;
+      }
+      if (action == SOLVE) {
+        return !solve_main(game, seed, max_nodes, (unsigned long)max_memory * 1024 * 1024);
+      } else if (action == PERFT) {
+        return !perft_main(game, seed, depth);
+      } else if (action == REPLAY) {
+        error = !replay_main(game, replay);
+        delete_replay(replay);
+        return error;
+      } else {
+        FILE *out = stdout;
+        if (output) {
+          out = fopen(output, "w");
+          if (!out) {
+            printf("%s: %s\n", output, strerror(errno));
+            return 1;
+          }
+        }
+        if (workers <= 0) {
+          workers = count_processors();
+        }
+        error = !survey_main(game, first_seed, last_seed, workers, max_nodes,
+            (unsigned long)max_memory * 1024 * 1024, out);
+        if (output) {
+          fclose(out);
+        }
+        return error;
+      }
+    case PLAYOUTS: {
+      FILE *out = stdout;
+      if (count > 0) {
+        last_seed = first_seed + (count - 1);
+      }
+      if (workers <= 0) {
+        workers = count_processors();
+      }
+      if (game_name) {
+        game = get_game(game_name);
+        if (!game) {
+          printf("game not found: '%s'\n", game_name);
+          return 1;
+        }
+      }
+      if (output) {
+        out = fopen(output, "w");
+        if (!out) {
+          printf("%s: %s\n", output, strerror(errno));
+          return 1;
+        }
+      }
+      if (game_name) {
+        error = !playout_main(game, first_seed, last_seed, workers, out);
+      } else {
+        GameList *list;
+        load_game_dirs();
+        for (list = list_games(); list; list = list->next) {
+          if (!playout_main(list->game, first_seed, last_seed, workers, out)) {
+            error = 1;
+          }
+        }
+      }
+      if (output) {
+        fclose(out);
+      }
+      return error;
+    }
   }
   return 0;
 }
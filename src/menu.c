@@ -4,12 +4,18 @@
  * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
  */
 
+#define _XOPEN_SOURCE 500
+
 #include "menu.h"
 
 #include "theme.h"
 #include "game.h"
 #include "rc.h"
+#include "color.h"
+#include "render.h"
+#include "term.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
@@ -29,14 +35,31 @@ Menu theme_menu[] = {
   {NULL, NULL, 0, NULL, NULL}
 };
 
+/* Maximum length of a message including the terminating null byte */
+#define MESSAGE_BUFFER_SIZE 256
+
+/* Box drawing characters in code page 437 and as Unicode code points */
+static const uint32_t box_chars[2][6] = {
+  {218, 191, 192, 217, 196, 179},
+  {0x250C, 0x2510, 0x2514, 0x2518, 0x2500, 0x2502}
+};
+
+enum {BOX_UL, BOX_UR, BOX_LL, BOX_LR, BOX_H, BOX_V};
+
+int message_shown = 0;
+
 void ui_message(const char *format, ...) {
+  Screen *screen = term_screen();
+  char message[MESSAGE_BUFFER_SIZE];
   va_list va;
-  move(0, 0);
-  clrtoeol();
   va_start(va, format);
-  move(0, 0);
-  vw_printw(stdscr, format, va);
+  vsnprintf(message, sizeof(message), format, va);
   va_end(va);
+  screen->pair = COLOR_PAIR_BACKGROUND;
+  screen->attr = 0;
+  screen_fill(screen, 0, 0, screen->width);
+  screen_print(screen, 0, 0, message);
+  message_shown = 1;
 }
 
 int ui_confirm(const char *message) {
@@ -50,76 +73,50 @@ int ui_confirm(const char *message) {
 }
 
 static void clear_box(int y, int x, int height, int width) {
-  int i;
-  move(y, x);
+  Screen *screen = term_screen();
+  screen->pair = COLOR_PAIR_BACKGROUND;
+  screen->attr = 0;
   while (height-- > 0) {
-    move(y++, x);
-    for (i = 0; i < width; i++) {
-      addch(' ');
-    }
+    screen_fill(screen, y++, x, width);
   }
 }
 
-void ui_box(int y, int x, int height, int width, int fill) {
+static void put_box_char(Screen *screen, int y, int x, int box_char) {
+  Cell cell;
+  cell.ch = box_chars[screen->utf8 != 0][box_char];
+  cell.pair = screen->pair;
+  cell.attr = screen->attr;
+  screen_put(screen, y, x, &cell, 1);
+}
+
+/* Draws a horizontal line of `width` cells ending in the given corners */
+static void put_box_line(Screen *screen, int y, int x, int width, int left, int right) {
   int i;
-  move(y, x);
   for (i = 0; i < width; i++) {
-    if (height && i == 0) {
-      addch(ACS_ULCORNER);
-    } else if (height && i + 1 >= width) {
-      addch(ACS_URCORNER);
-    } else {
-      addch(ACS_HLINE);
-    }
+    put_box_char(screen, y, x + i, i == 0 ? left : i + 1 >= width ? right : BOX_H);
+  }
+}
+
+void ui_box(Screen *screen, int y, int x, int height, int width, int fill) {
+  if (!height) {
+    put_box_line(screen, y, x, width, BOX_H, BOX_H);
+    return;
   }
+  put_box_line(screen, y, x, width, BOX_UL, BOX_UR);
   if (height > 1) {
     while (--height > 1) {
-      move(++y, x);
-      addch(ACS_VLINE);
+      put_box_char(screen, ++y, x, BOX_V);
       if (fill) {
-        for (i = 2; i < width; i++) {
-          addch(' ');
-        }
-      } else {
-        move(y, x + width - 1);
-      }
-      addch(ACS_VLINE);
-    }
-    move(++y, x);
-    for (i = 0; i < width; i++) {
-      if (i == 0) {
-        addch(ACS_LLCORNER);
-      } else if (i + 1 >= width) {
-        addch(ACS_LRCORNER);
-      } else {
-        addch(ACS_HLINE);
+        screen_fill(screen, y, x + 1, width - 2);
       }
+      put_box_char(screen, y, x + width - 1, BOX_V);
     }
-  }
-}
-
-static void print_menu_label(const char *label, int show_mnemonic) {
-  while (*label) {
-    if (*label == '&') {
-      label++;
-      if (show_mnemonic) {
-        attron(A_BOLD);
-      }
-      if (*label) {
-        printw("%c", *label);
-        label++;
-      }
-      if (show_mnemonic) {
-        attroff(A_BOLD);
-      }
-    } else {
-      printw("%c", *label);
-      label++;
-    }
+    put_box_line(screen, ++y, x, width, BOX_LL, BOX_LR);
   }
 }
 
 static int ui_menu(int y, int x, Menu *menu, Menu **selection, int *y_max, int *x_max, MenuClick *click) {
+  Screen *screen = term_screen();
   Menu *item;
   int max_length = 0;
   int height = 0;
@@ -134,22 +131,23 @@ static int ui_menu(int y, int x, Menu *menu, Menu **selection, int *y_max, int *
     }
     height++;
   }
-  ui_box(y++, x, height + 2, max_length + 4, 1);
+  screen->pair = COLOR_PAIR_BACKGROUND;
+  screen->attr = 0;
+  ui_box(screen, y++, x, height + 2, max_length + 4, 1);
   for (item = menu; item->label; item++) {
     if (click->click && click->y == y && click->x >= x + 1 && click->x <= x + 1 + max_length) {
       click->click = 0;
       selection[0] = item;
       activate = 1;
     }
-    if (item == *selection) {
-      attron(A_REVERSE);
-    }
-    mvprintw(y, x + 1, " %*s ", max_length, item->key ? item-> key : "");
-    move(y, x + 2);
-    print_menu_label(item->label, *selection != NULL);
-    if (item == *selection) {
-      attroff(A_REVERSE);
+    screen->pair = COLOR_PAIR_BACKGROUND;
+    screen->attr = item == *selection ? SCREEN_REVERSE : 0;
+    screen_fill(screen, y, x + 1, max_length + 2);
+    if (item->key) {
+      screen_print(screen, y, x + 2 + max_length - strlen(item->key), item->key);
     }
+    draw_menu_label(screen, y, x + 2, item->label, *selection != NULL);
+    screen->attr = 0;
     y++;
   }
   *y_max = y + 1;
@@ -187,8 +185,7 @@ static void close_menu(int y_min, int y_max, int x_min, int x_max, Menu **menu_s
   menu_selection[1] = NULL;
   clear_box(y_min, x_min, y_max - y_min, x_max - x_min);
   if (!show_menu) {
-    move(0, 0);
-    clrtoeol();
+    clear_box(0, 0, 1, term_screen()->width);
   }
 }
 
@@ -200,24 +197,26 @@ int ui_menubar(Menu *menu, Menu **menu_selection, void **data, MenuClick *click)
     return MENU_IS_CLOSED;
   }
   do {
-    int activate = 0;
-    move(0, 0);
-    printw(" ");
+    Screen *screen = term_screen();
+    int activate = 0, x;
+    screen->pair = COLOR_PAIR_BACKGROUND;
+    screen->attr = 0;
+    x = screen_print(screen, 0, 0, " ");
     for (item = menu; item->label; item++) {
-      int x1 = getcurx(stdscr), x2;
+      int x1 = x, x2;
       if (item == menu_selection[0]) {
-        attron(A_REVERSE);
-        printw(" ");
-        print_menu_label(item->label, !menu_selection[1]);
-        printw(" ");
-        attroff(A_REVERSE);
-        x2 = getcurx(stdscr);
+        screen->attr = SCREEN_REVERSE;
+        x = screen_print(screen, 0, x, " ");
+        x = draw_menu_label(screen, 0, x, item->label, !menu_selection[1]);
+        x = screen_print(screen, 0, x, " ");
+        screen->attr = 0;
+        x2 = x;
         if (item->submenu) {
           if (item->submenu == game_menu) {
             GameList *list;
             int size = 0, i = 0;
-            ui_box(1, x1 - 1, 3, 14, 1);
-            mvprintw(2, x1 + 1, "Loading...");
+            ui_box(screen, 1, x1 - 1, 3, 14, 1);
+            screen_print(screen, 2, x1 + 1, "Loading...");
             refresh();
             load_game_dirs();
             for (list = list_games(); list; list = list->next) {
@@ -240,8 +239,8 @@ int ui_menubar(Menu *menu, Menu **menu_selection, void **data, MenuClick *click)
           } else if (item->submenu == theme_menu) {
             ThemeList *list;
             int size = 0, i = 0;
-            ui_box(1, x1 - 1, 3, 14, 1);
-            mvprintw(2, x1 + 1, "Loading...");
+            ui_box(screen, 1, x1 - 1, 3, 14, 1);
+            screen_print(screen, 2, x1 + 1, "Loading...");
             refresh();
             load_theme_dirs();
             for (list = list_themes(); list; list = list->next) {
@@ -266,12 +265,11 @@ int ui_menubar(Menu *menu, Menu **menu_selection, void **data, MenuClick *click)
             activate = 1;
           }
         }
-        move(0, x2);
       } else {
-        printw(" ");
-        print_menu_label(item->label, !menu_selection[1]);
-        printw(" ");
-        x2 = getcurx(stdscr);
+        x = screen_print(screen, 0, x, " ");
+        x = draw_menu_label(screen, 0, x, item->label, !menu_selection[1]);
+        x = screen_print(screen, 0, x, " ");
+        x2 = x;
       }
       if (click->click && click->y == 0 && click->x >= x1 && click->x <= x2) {
         menu_selection[0] = item;
@@ -7,6 +7,8 @@
 #ifndef MENU_H
 #define MENU_H
 
+#include "screen.h"
+
 typedef struct Menu Menu;
 
 struct Menu {
@@ -31,9 +33,15 @@ typedef struct {
 extern Menu game_menu[];
 extern Menu theme_menu[];
 
+/* Set by ui_message. The user interface clears it once the message has been
+ * erased. */
+extern int message_shown;
+
 void ui_message(const char *format, ...);
 int ui_confirm(const char *message);
-void ui_box(int y, int x, int height, int width, int fill);
+/* Draws a box with the current color pair and attributes of `screen`. The
+ * inside is cleared if `fill` is set. */
+void ui_box(Screen *screen, int y, int x, int height, int width, int fill);
 void open_menu(int mnemonic, Menu *menu, Menu **menu_selection);
 int ui_menubar(Menu *menu, Menu **menu_selection, void **data, MenuClick *click);
 
@@ -0,0 +1,96 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#include "perft.h"
+#include "solver.h"
+#include "rng.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+unsigned long perft(GameState *state, MoveList **lists, int depth, long *errors) {
+  MoveList *list = lists[0];
+  unsigned long nodes = 0;
+  int i;
+  if (depth <= 0) {
+    return 1;
+  }
+  generate_moves(state->piles, list);
+  for (i = 0; i < list->size; i++) {
+    uint64_t hash = state->hash;
+    if (!play_move(state, list->moves[i])) {
+      (*errors)++;
+      continue;
+    }
+    nodes += perft(state, lists + 1, depth - 1, errors);
+    undo_move(state);
+    if (state->hash != hash) {
+      (*errors)++;
+    }
+  }
+  return nodes;
+}
+
+int perft_main(Game *game, unsigned int seed, int depth) {
+  Arena *arena = new_arena(DEAL_ARENA_SIZE);
+  MoveList **lists;
+  MoveList *root;
+  Card *deck;
+  GameState *state;
+  Rng rng;
+  unsigned long start;
+  double seconds;
+  unsigned long nodes = 0;
+  long errors = 0;
+  int i;
+  if (depth < 1) {
+    printf("perft: depth must be at least 1\n");
+    delete_arena(arena);
+    return 0;
+  }
+  rng_seed(&rng, seed);
+  deck = new_deck(arena, game->decks, game->deck_suits);
+  shuffle_stack(next_card(deck), &rng);
+  state = new_game_state(arena, game, deck);
+  lists = malloc(depth * sizeof(MoveList *));
+  for (i = 0; i < depth; i++) {
+    lists[i] = new_move_list();
+  }
+  root = lists[0];
+  printf("%s #%u: perft depth %d\n", game->name, seed, depth);
+  start = get_milliseconds();
+  generate_moves(state->piles, root);
+  for (i = 0; i < root->size; i++) {
+    unsigned long count;
+    uint64_t hash = state->hash;
+    print_move(stdout, root->moves[i], state->piles);
+    if (!play_move(state, root->moves[i])) {
+      printf(": rejected\n");
+      errors++;
+      continue;
+    }
+    count = perft(state, lists + 1, depth - 1, &errors);
+    undo_move(state);
+    if (state->hash != hash) {
+      errors++;
+    }
+    printf(": %lu\n", count);
+    nodes += count;
+  }
+  seconds = (get_milliseconds() - start) / 1000.0;
+  printf("moves: %d, nodes: %lu, time: %ld ms, %.0f nodes/s\n", root->size, nodes, (long)(seconds * 1000),
+      seconds > 0 ? nodes / seconds : 0.0);
+  if (errors) {
+    printf("errors: %ld\n", errors);
+  }
+  for (i = 0; i < depth; i++) {
+    delete_move_list(lists[i]);
+  }
+  free(lists);
+  delete_arena(arena);
+  return !errors;
+}
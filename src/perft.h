@@ -0,0 +1,23 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#ifndef PERFT_H
+#define PERFT_H
+
+#include "game.h"
+
+/* Counts the sequences of `depth` moves that can be played from the current
+ * position. Every move is undone again, and `errors` is incremented for each
+ * generated move that is rejected or that doesn't restore the position when
+ * undone. */
+unsigned long perft(GameState *state, MoveList **lists, int depth, long *errors);
+
+/* Deals the game with the given seed and prints the number of move sequences
+ * of length `depth` following each move from the deal, the total, and the
+ * number of sequences counted per second. */
+int perft_main(Game *game, unsigned int seed, int depth);
+
+#endif
@@ -12,6 +12,8 @@
 #include "game.h"
 #include "util.h"
 #include "scores.h"
+#include "replay.h"
+#include "save.h"
 #include "error.h"
 
 #include <stdio.h>
@@ -103,7 +105,14 @@ typedef enum {
   K_ALL,
   K_TO,
   K_TURN,
-  K_SHOW_MENU
+  K_SHOW_MENU,
+  K_UNDO_LIMIT,
+  K_REPLAYS,
+  K_REPLAY_DIR,
+  K_AUTOSAVE,
+  K_SAVE_DIR,
+  K_HINT_TIME,
+  K_FRAME_RATE
 } Keyword;
 
 struct symbol {
@@ -128,6 +137,13 @@ struct symbol root_commands[] = {
   {"keep_vertical_position", K_KEEP_VERTICAL_POSITION},
   {"alt_cursor", K_ALT_CURSOR},
   {"show_menu", K_SHOW_MENU},
+  {"undo_limit", K_UNDO_LIMIT},
+  {"replays", K_REPLAYS},
+  {"replay_dir", K_REPLAY_DIR},
+  {"autosave", K_AUTOSAVE},
+  {"save_dir", K_SAVE_DIR},
+  {"hint_time", K_HINT_TIME},
+  {"frame_rate", K_FRAME_RATE},
   {NULL, K_UNDEFINED}
 };
 
@@ -241,6 +257,12 @@ int alt_cursor = 0;
 
 int show_menu = 0;
 
+int undo_limit = 0;
+
+int hint_time = 200;
+
+int frame_rate = 0;
+
 char *user_rc_path = NULL;
 
 static int read_char(FILE *file) {
@@ -1079,6 +1101,31 @@ int execute_file(const char *file_name) {
       case K_SHOW_MENU:
         show_menu = read_int(file);
         break;
+      case K_UNDO_LIMIT:
+        undo_limit = read_int(file);
+        break;
+      case K_HINT_TIME:
+        hint_time = read_int(file);
+        break;
+      case K_FRAME_RATE:
+        frame_rate = read_int(file);
+        break;
+      case K_REPLAYS:
+        replays_enabled = read_int(file);
+        break;
+      case K_REPLAY_DIR:
+        value = read_value(file);
+        replay_dir_path = combine_paths(cwd, value);
+        free(value);
+        break;
+      case K_AUTOSAVE:
+        autosave_enabled = read_int(file);
+        break;
+      case K_SAVE_DIR:
+        value = read_value(file);
+        save_dir_path = combine_paths(cwd, value);
+        free(value);
+        break;
       default:
         break;
     }
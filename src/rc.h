@@ -17,6 +17,9 @@ extern int keep_vertical_position;
 extern int alt_cursor;
 extern int show_score;
 extern int show_menu;
+extern int undo_limit;
+extern int hint_time;
+extern int frame_rate;
 
 int execute_file(const char *file);
 void execute_dir(const char *dir);
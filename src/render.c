@@ -0,0 +1,349 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#include "render.h"
+
+#include "card.h"
+#include "color.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Number of glyphs for each selection state: face up cards, face down cards,
+ * and empty piles of every rank */
+#define GLYPH_COUNT (2 * CARD_IDS + KING + 1)
+
+/* Extra columns for text that overflows a card while its glyph is rendered */
+#define GLYPH_MARGIN 8
+
+/* Pre-rendered cards of the current theme, see cache_glyphs */
+static Cell *glyphs = NULL;
+static int glyph_width = 0;
+static int glyph_height = 0;
+
+int theme_x(int x, Theme *theme) {
+  return theme->x_margin + x * (theme->width + theme->x_spacing);
+}
+
+int theme_y(int y, Theme *theme, int off_y) {
+  return theme->y_margin + off_y + y;
+}
+
+static void print_card_name_l(Screen *screen, int y, int x, Card *card, Theme *theme) {
+  x = screen_print(screen, y, x, theme->ranks[card->rank - 1]);
+  screen_print(screen, y, x, card_suit(card, theme));
+}
+
+static void print_card_name_r(Screen *screen, int y, int x, Card *card, Theme *theme) {
+  char *suit_symbol = card_suit(card, theme);
+  char *rank_symbol = theme->ranks[card->rank - 1];
+  x -= text_width(screen, suit_symbol) + text_width(screen, rank_symbol);
+  x = screen_print(screen, y, x, suit_symbol);
+  screen_print(screen, y, x, rank_symbol);
+}
+
+static void print_text(Screen *screen, int y, int x, Card *card, Text text, int fill, Theme *theme) {
+  char *suit_symbol = "", *rank_symbol = "";
+  if ((!fill && text.y != 0) || !text.format) {
+    return;
+  }
+  if (text.y < 0) {
+    y += theme->height + text.y;
+  }
+  if (text.x < 0) {
+    x += theme->width + text.x;
+  }
+  if (text.format == TEXT_RANK_SUIT || text.format == TEXT_SUIT_RANK
+      || text.format == TEXT_SUIT) {
+    suit_symbol = card_suit(card, theme);
+  }
+  if (text.format == TEXT_RANK_SUIT || text.format == TEXT_SUIT_RANK
+      || text.format == TEXT_RANK) {
+    rank_symbol = theme->ranks[card->rank - 1];
+  }
+  if (text.align_right) {
+    x -= text_width(screen, suit_symbol) + text_width(screen, rank_symbol) - 1;
+  }
+  if (text.format == TEXT_RANK_SUIT) {
+    x = screen_print(screen, y, x, rank_symbol);
+    screen_print(screen, y, x, suit_symbol);
+  } else {
+    x = screen_print(screen, y, x, suit_symbol);
+    screen_print(screen, y, x, rank_symbol);
+  }
+}
+
+static void print_layout(Screen *screen, int y, int x, Card *card, Layout layout, int full, Theme *theme) {
+  Text *field;
+  screen_print(screen, y, x, layout.top);
+  if (full && theme->height > 1) {
+    int i;
+    for (i = 1; i < theme->height - 1; i++) {
+      screen_print(screen, y + i, x, layout.middle);
+    }
+    screen_print(screen, y + theme->height - 1, x, layout.bottom);
+  }
+  for (field = layout.text_fields; field; field = field->next) {
+    print_text(screen, y, x, card, *field, full, theme);
+  }
+}
+
+/* Draws a card from the theme's layouts and card names */
+static void render_card(Screen *screen, int y, int x, Card *card, int full, Theme *theme) {
+  if (card->suit & BOTTOM) {
+    screen->pair = COLOR_PAIR_EMPTY;
+    print_layout(screen, y, x, card, theme->empty_layout, full, theme);
+    if (!theme->empty_layout.text_fields && card->rank > 0) {
+      print_card_name_l(screen, y, x + theme->empty_layout.left_padding, card, theme);
+    }
+  } else if (!card->up) {
+    screen->pair = COLOR_PAIR_BACK;
+    print_layout(screen, y, x, card, theme->back_layout, full, theme);
+  } else {
+    int left_padding, right_padding, has_text;
+    if (card->suit & RED) {
+      screen->pair = COLOR_PAIR_RED;
+      print_layout(screen, y, x, card, theme->red_layout, full, theme);
+      left_padding = theme->red_layout.left_padding;
+      right_padding = theme->red_layout.right_padding;
+      has_text = !!theme->red_layout.text_fields;
+    } else {
+      screen->pair = COLOR_PAIR_BLACK;
+      print_layout(screen, y, x, card, theme->black_layout, full, theme);
+      left_padding = theme->black_layout.left_padding;
+      right_padding = theme->black_layout.right_padding;
+      has_text = !!theme->black_layout.text_fields;
+    }
+    if (!has_text) {
+      if (full && theme->height > 1) {
+        print_card_name_r(screen, y + theme->height - 1, x + theme->width - right_padding, card, theme);
+      }
+      print_card_name_l(screen, y, x + left_padding, card, theme);
+    }
+  }
+}
+
+/* Returns the first row of the glyph of a card. The `theme->height` rows of a
+ * fully visible card are followed by the single row of a card that is only
+ * visible at the top. */
+static Cell *get_glyph(Card *card, int selected) {
+  int index;
+  if (card->suit & BOTTOM) {
+    index = 2 * CARD_IDS + card->rank;
+  } else {
+    index = (card->up ? 0 : CARD_IDS) + card->id;
+  }
+  return glyphs + (2 * index + selected) * glyph_height * glyph_width;
+}
+
+static void copy_row(Screen *glyph_screen, int y, Cell *row) {
+  memcpy(row, get_screen_row(glyph_screen, y), glyph_width * sizeof(Cell));
+}
+
+/* Pre-renders every card of a theme into `glyphs`, so that draw_card only has
+ * to copy rows to the screen */
+void cache_glyphs(Theme *theme) {
+  Screen *glyph_screen;
+  Card card;
+  int i, selected, full, row;
+  glyph_width = theme->width;
+  glyph_height = theme->height + 1;
+  free(glyphs);
+  glyphs = malloc(2 * GLYPH_COUNT * glyph_height * glyph_width * sizeof(Cell));
+  /* Text that doesn't fit on the card is written to the margin of the screen
+   * and discarded */
+  glyph_screen = new_memory_screen(2 * theme->width + GLYPH_MARGIN, theme->height, theme->utf8);
+  for (i = 0; i < GLYPH_COUNT; i++) {
+    if (i < 2 * CARD_IDS) {
+      init_card(&card, suits[i % CARD_IDS / 13], i % CARD_IDS % 13 + 1);
+      card.up = i < CARD_IDS;
+    } else {
+      init_card(&card, TABLEAU, i - 2 * CARD_IDS);
+    }
+    for (selected = 0; selected < 2; selected++) {
+      Cell *rows = get_glyph(&card, selected);
+      for (full = 0; full < 2; full++) {
+        screen_erase(glyph_screen);
+        glyph_screen->attr = selected ? SCREEN_REVERSE : 0;
+        render_card(glyph_screen, 0, 0, &card, full, theme);
+        if (full) {
+          for (row = 0; row < theme->height; row++) {
+            copy_row(glyph_screen, row, rows + row * glyph_width);
+          }
+        } else {
+          copy_row(glyph_screen, 0, rows + theme->height * glyph_width);
+        }
+      }
+    }
+  }
+  delete_memory_screen(glyph_screen);
+}
+
+void free_glyphs() {
+  free(glyphs);
+  glyphs = NULL;
+}
+
+/* The first card of a pile that is laid out and drawn. Only the top card of
+ * a pile is shown, except on a tableau where all cards are. */
+Card *get_first_shown(Pile *pile) {
+  if (pile->rule->type != RULE_STOCK && pile->stack->suit == TABLEAU && next_card(pile->stack)) {
+    return next_card(pile->stack);
+  }
+  return get_top(pile->stack);
+}
+
+/* Sets the grid positions of the visible cards of a pile */
+static void layout_pile(Pile *pile, Theme *theme) {
+  int y = pile->rule->y * (theme->height + theme->y_spacing);
+  Card *card;
+  for (card = get_first_shown(pile); card; card = next_card(card), y++) {
+    card->x = pile->rule->x;
+    card->y = y;
+  }
+}
+
+void layout_piles(GameState *state, Theme *theme, int all) {
+  Pile *pile;
+  for (pile = state->piles; pile; pile = pile->next) {
+    if (all || state->damage[pile->index]) {
+      layout_pile(pile, theme);
+    }
+  }
+}
+
+/* Draws a card at a screen position from its pre-rendered glyph. If `full` is
+ * not set, only the top row of the card is drawn. */
+void draw_card(Screen *screen, int y, int x, Card *card, int full, int selected) {
+  Cell *rows = get_glyph(card, selected);
+  int i;
+  if (!full) {
+    screen_put(screen, y, x, rows + (glyph_height - 1) * glyph_width, glyph_width);
+    return;
+  }
+  for (i = 0; i < glyph_height - 1; i++) {
+    screen_put(screen, y + i, x, rows + i * glyph_width, glyph_width);
+  }
+}
+
+static void draw_pile(Screen *screen, Pile *pile, Theme *theme, int off_y, Card *selection) {
+  Card *top = get_top(pile->stack);
+  Card *card;
+  for (card = get_first_shown(pile); card != top; card = next_card(card)) {
+    draw_card(screen, theme_y(card->y, theme, off_y), theme_x(card->x, theme), card, 0,
+        card == selection);
+  }
+  draw_card(screen, theme_y(top->y, theme, off_y), theme_x(top->x, theme), top, 1, top == selection);
+}
+
+static int pile_top(Pile *pile, Theme *theme) {
+  return pile->rule->y * (theme->height + theme->y_spacing);
+}
+
+/* The last row of the pile as laid out by layout_pile */
+static int pile_bottom(Pile *pile, Theme *theme) {
+  return get_top(pile->stack)->y + theme->height - 1;
+}
+
+/* The last row covered by the pile before or after the current frame */
+static int pile_extent(Pile *pile, Theme *theme, int *bottoms) {
+  int bottom = pile_bottom(pile, theme);
+  return bottoms[pile->index] > bottom ? bottoms[pile->index] : bottom;
+}
+
+static void erase_rows(Screen *screen, int x, int y1, int y2, Theme *theme, int off_y) {
+  x = theme_x(x, theme);
+  screen->pair = COLOR_PAIR_BACKGROUND;
+  screen->attr = 0;
+  for (; y1 <= y2; y1++) {
+    screen_fill(screen, theme_y(y1, theme, off_y), x, theme->width);
+  }
+}
+
+/* Lays out, erases and redraws the piles that have changed since the last
+ * frame: those damaged by moves or by the caller, and those overlapping the
+ * area of another redrawn pile. `bottoms` holds the last row of each pile as
+ * it was drawn. If `all` is set, the screen is erased and everything is
+ * redrawn, and `bottoms` may be NULL. */
+void draw_piles(Screen *screen, GameState *state, Theme *theme, int off_y, Card *selection,
+    int *bottoms, int all) {
+  unsigned char *damage = state->damage;
+  Pile *pile, *other;
+  int changed = 1;
+  if (all) {
+    screen_erase(screen);
+    memset(damage, 1, state->pile_count);
+  }
+  layout_piles(state, theme, all);
+  while (!all && changed) {
+    changed = 0;
+    for (pile = state->piles; pile; pile = pile->next) {
+      int top = pile_top(pile, theme), bottom = pile_extent(pile, theme, bottoms);
+      if (!damage[pile->index]) {
+        continue;
+      }
+      for (other = state->piles; other; other = other->next) {
+        if (!damage[other->index] && other->rule->x == pile->rule->x
+            && pile_top(other, theme) <= bottom && top <= pile_extent(other, theme, bottoms)) {
+          damage[other->index] = 1;
+          changed = 1;
+        }
+      }
+    }
+  }
+  for (pile = state->piles; pile; pile = pile->next) {
+    if (damage[pile->index] && !all) {
+      erase_rows(screen, pile->rule->x, pile_top(pile, theme), bottoms[pile->index], theme, off_y);
+    }
+  }
+  for (pile = state->piles; pile; pile = pile->next) {
+    if (damage[pile->index]) {
+      draw_pile(screen, pile, theme, off_y, selection);
+      if (bottoms) {
+        bottoms[pile->index] = pile_bottom(pile, theme);
+      }
+    }
+  }
+  memset(damage, 0, state->pile_count);
+}
+
+/* Prints the score on the last line. The line is padded to `width` to cover
+ * a longer score, and `width` is updated. */
+void draw_score(Screen *screen, int32_t score, int *width) {
+  char buffer[32];
+  int x;
+  sprintf(buffer, "Score: %" PRId32, score);
+  screen->pair = COLOR_PAIR_BACKGROUND;
+  screen->attr = 0;
+  x = screen_print(screen, screen->height - 1, 0, buffer);
+  if (x < *width) {
+    screen_fill(screen, screen->height - 1, x, *width - x);
+  }
+  *width = x;
+}
+
+/* Prints a menu label with the character after '&' in bold. Returns the
+ * column after the label. */
+int draw_menu_label(Screen *screen, int y, int x, const char *label, int show_mnemonic) {
+  unsigned char attr = screen->attr;
+  char ch[2] = {0, 0};
+  while (*label) {
+    if (*label == '&') {
+      label++;
+      if (!*label) {
+        break;
+      }
+      if (show_mnemonic) {
+        screen->attr |= SCREEN_BOLD;
+      }
+    }
+    ch[0] = *label++;
+    x = screen_print(screen, y, x, ch);
+    screen->attr = attr;
+  }
+  return x;
+}
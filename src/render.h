@@ -0,0 +1,31 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "screen.h"
+#include "theme.h"
+#include "game.h"
+#include "menu.h"
+
+int theme_x(int x, Theme *theme);
+int theme_y(int y, Theme *theme, int off_y);
+
+void cache_glyphs(Theme *theme);
+void free_glyphs();
+
+Card *get_first_shown(Pile *pile);
+/* Lays out the piles damaged since the last frame, or every pile if `all` is
+ * set. The damage is left for draw_piles. */
+void layout_piles(GameState *state, Theme *theme, int all);
+void draw_card(Screen *screen, int y, int x, Card *card, int full, int selected);
+void draw_piles(Screen *screen, GameState *state, Theme *theme, int off_y, Card *selection,
+    int *bottoms, int all);
+void draw_score(Screen *screen, int32_t score, int *width);
+int draw_menu_label(Screen *screen, int y, int x, const char *label, int show_mnemonic);
+
+#endif
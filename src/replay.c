@@ -0,0 +1,300 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#define _XOPEN_SOURCE 500
+
+#include "replay.h"
+
+#include "util.h"
+#include "error.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+/* Replay files start with this signature followed by a version byte, the
+ * length and name of the game, the seed, the number of records and the
+ * records. Since version 2 the records are followed by the keyframe interval,
+ * the number of keyframes, and the size and data of each keyframe. All
+ * numbers are little-endian. */
+#define REPLAY_SIGNATURE "CSR"
+#define REPLAY_VERSION 2
+
+/* Number of records between keyframes */
+#define KEYFRAME_INTERVAL 64
+
+/* Upper bound on the size of a keyframe in a replay file */
+#define MAX_KEYFRAME_SIZE 0x100000
+
+int replays_enabled = 0;
+char *replay_dir_path = NULL;
+
+int touch_replay_dir(const char *arg0) {
+  if (!replays_enabled) {
+    return 1;
+  }
+  if (!replay_dir_path) {
+    replay_dir_path = find_data_file("replays", arg0);
+  }
+  if (!replay_dir_path) {
+    printf("Could not find a place to put replays\n");
+    return 0;
+  }
+  return mkdir_rec(replay_dir_path);
+}
+
+static void write_uint32(FILE *f, uint32_t value) {
+  unsigned char bytes[4];
+  bytes[0] = value & 0xFF;
+  bytes[1] = value >> 8 & 0xFF;
+  bytes[2] = value >> 16 & 0xFF;
+  bytes[3] = value >> 24 & 0xFF;
+  fwrite(bytes, 1, 4, f);
+}
+
+static int read_uint32(FILE *f, uint32_t *value) {
+  unsigned char bytes[4];
+  if (fread(bytes, 1, 4, f) != 4) {
+    return 0;
+  }
+  *value = (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+  return 1;
+}
+
+static GameState *deal_replay(Arena *arena, Game *game, uint32_t seed) {
+  Card *deck;
+  Rng rng;
+  rng_seed(&rng, seed);
+  deck = new_deck(arena, game->decks, game->deck_suits);
+  shuffle_stack(next_card(deck), &rng);
+  return new_game_state(arena, game, deck);
+}
+
+/* Makes the keyframes of a move log by replaying it on a new deal. A
+ * keyframe only needs the part of the undo history that the records up to
+ * the next keyframe can reach. */
+static Keyframe *make_keyframes(Game *game, uint32_t seed, GameState *state, int *count) {
+  Arena *arena = new_arena(DEAL_ARENA_SIZE);
+  GameState *replay_state = deal_replay(arena, game, seed);
+  Keyframe *keyframes = malloc((state->log_size / KEYFRAME_INTERVAL + 1) * sizeof(Keyframe));
+  int i;
+  *count = 0;
+  for (i = 0; i < state->log_size; i++) {
+    if (!replay_record(replay_state, state->log[i])) {
+      break;
+    }
+    if ((i + 1) % KEYFRAME_INTERVAL == 0) {
+      Keyframe *keyframe = &keyframes[(*count)++];
+      keyframe->data = serialize_game_state(replay_state, KEYFRAME_INTERVAL, &keyframe->size);
+    }
+  }
+  delete_arena(arena);
+  return keyframes;
+}
+
+int save_replay(const char *path, Game *game, uint32_t seed, GameState *state) {
+  FILE *f;
+  Keyframe *keyframes;
+  size_t name_length = strlen(game->name);
+  int i, keyframe_count;
+  if (name_length > 255) {
+    name_length = 255;
+  }
+  f = fopen(path, "wb");
+  if (!f) {
+    return 0;
+  }
+  fwrite(REPLAY_SIGNATURE, 1, 3, f);
+  fputc(REPLAY_VERSION, f);
+  fputc((int)name_length, f);
+  fwrite(game->name, 1, name_length, f);
+  write_uint32(f, seed);
+  write_uint32(f, state->log_size);
+  for (i = 0; i < state->log_size; i++) {
+    write_uint32(f, state->log[i]);
+  }
+  keyframes = make_keyframes(game, seed, state, &keyframe_count);
+  write_uint32(f, KEYFRAME_INTERVAL);
+  write_uint32(f, keyframe_count);
+  for (i = 0; i < keyframe_count; i++) {
+    write_uint32(f, keyframes[i].size);
+    fwrite(keyframes[i].data, 1, keyframes[i].size, f);
+    free(keyframes[i].data);
+  }
+  free(keyframes);
+  if (ferror(f)) {
+    fclose(f);
+    return 0;
+  }
+  return fclose(f) == 0;
+}
+
+int archive_replay(Game *game, uint32_t seed, GameState *state) {
+  char name[300];
+  char date[20];
+  char *path;
+  time_t now;
+  if (!replays_enabled || !replay_dir_path || !state->log_size) {
+    return 1;
+  }
+  now = time(NULL);
+  strftime(date, sizeof(date), "%Y%m%d%H%M%S", localtime(&now));
+  sprintf(name, "%.255s-%" PRIu32 "-%s.csr", game->name, seed, date);
+  path = combine_paths(replay_dir_path, name);
+  if (!save_replay(path, game, seed, state)) {
+    print_error("Saving replay failed: %s: %s", path, strerror(errno));
+    free(path);
+    return 0;
+  }
+  free(path);
+  return 1;
+}
+
+Replay *load_replay(const char *path) {
+  Replay *replay;
+  char signature[4];
+  uint32_t size, interval, count;
+  int name_length, i;
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    printf("%s: %s\n", path, strerror(errno));
+    return NULL;
+  }
+  if (fread(signature, 1, 4, f) != 4 || memcmp(signature, REPLAY_SIGNATURE, 3) != 0) {
+    printf("%s: not a replay file\n", path);
+    fclose(f);
+    return NULL;
+  }
+  if (signature[3] < 1 || signature[3] > REPLAY_VERSION) {
+    printf("%s: unsupported replay version: %d\n", path, signature[3]);
+    fclose(f);
+    return NULL;
+  }
+  replay = malloc(sizeof(Replay));
+  replay->records = NULL;
+  replay->size = 0;
+  replay->keyframe_interval = 0;
+  replay->keyframe_count = 0;
+  replay->keyframes = NULL;
+  name_length = fgetc(f);
+  replay->game = malloc(name_length < 0 ? 1 : name_length + 1);
+  replay->game[0] = '\0';
+  if (name_length < 0 || fread(replay->game, 1, name_length, f) != (size_t)name_length
+      || !read_uint32(f, &replay->seed) || !read_uint32(f, &size) || size > INT32_MAX / sizeof(LogRecord)) {
+    printf("%s: invalid replay file\n", path);
+    fclose(f);
+    delete_replay(replay);
+    return NULL;
+  }
+  replay->game[name_length] = '\0';
+  replay->records = malloc(size * sizeof(LogRecord) + 1);
+  for (i = 0; i < (int)size; i++) {
+    if (!read_uint32(f, &replay->records[i])) {
+      printf("%s: replay file is truncated\n", path);
+      fclose(f);
+      delete_replay(replay);
+      return NULL;
+    }
+  }
+  replay->size = size;
+  if (signature[3] >= 2) {
+    if (!read_uint32(f, &interval) || !read_uint32(f, &count) || interval < 1 || count > size / interval) {
+      printf("%s: invalid replay file\n", path);
+      fclose(f);
+      delete_replay(replay);
+      return NULL;
+    }
+    replay->keyframe_interval = interval;
+    replay->keyframes = malloc(count * sizeof(Keyframe) + 1);
+    for (i = 0; i < (int)count; i++) {
+      Keyframe *keyframe = &replay->keyframes[i];
+      if (!read_uint32(f, &size) || size > MAX_KEYFRAME_SIZE) {
+        printf("%s: invalid replay file\n", path);
+        fclose(f);
+        delete_replay(replay);
+        return NULL;
+      }
+      keyframe->data = malloc(size + 1);
+      keyframe->size = size;
+      replay->keyframe_count++;
+      if (fread(keyframe->data, 1, size, f) != size) {
+        printf("%s: replay file is truncated\n", path);
+        fclose(f);
+        delete_replay(replay);
+        return NULL;
+      }
+    }
+  }
+  fclose(f);
+  return replay;
+}
+
+void delete_replay(Replay *replay) {
+  int i;
+  for (i = 0; i < replay->keyframe_count; i++) {
+    free(replay->keyframes[i].data);
+  }
+  free(replay->keyframes);
+  free(replay->game);
+  free(replay->records);
+  free(replay);
+}
+
+/* Returns the number of the keyframe preceding record `position`, where 0 is
+ * the initial deal. */
+static int get_keyframe(Replay *replay, int position) {
+  int keyframe;
+  if (!replay->keyframe_count) {
+    return 0;
+  }
+  keyframe = position / replay->keyframe_interval;
+  return keyframe < replay->keyframe_count ? keyframe : replay->keyframe_count;
+}
+
+GameState *seek_replay(Arena *arena, Game *game, Replay *replay, GameState *state, int from, int to) {
+  int keyframe = get_keyframe(replay, to);
+  if (!state || to < from || get_keyframe(replay, from) != keyframe) {
+    clear_arena(arena);
+    if (keyframe) {
+      Keyframe *k = &replay->keyframes[keyframe - 1];
+      state = deserialize_game_state(arena, game, k->data, k->size);
+      from = keyframe * replay->keyframe_interval;
+    } else {
+      state = deal_replay(arena, game, replay->seed);
+      from = 0;
+    }
+    if (!state) {
+      return NULL;
+    }
+  }
+  for (; from < to; from++) {
+    if (!replay_record(state, replay->records[from])) {
+      return NULL;
+    }
+  }
+  return state;
+}
+
+int replay_main(Game *game, Replay *replay) {
+  Arena *arena = new_arena(DEAL_ARENA_SIZE);
+  GameState *state = deal_replay(arena, game, replay->seed);
+  int i, ok = 1;
+  for (i = 0; i < replay->size; i++) {
+    if (!replay_record(state, replay->records[i])) {
+      printf("%s #%" PRIu32 ": move %d is invalid\n", game->name, replay->seed, i + 1);
+      ok = 0;
+      break;
+    }
+  }
+  if (ok) {
+    printf("%s #%" PRIu32 ": %d records, %d moves, score %" PRId32 ", %s\n", game->name, replay->seed,
+        replay->size, state->move_counter, state->score, check_win_condition(state->piles) ? "won" : "not won");
+  }
+  delete_arena(arena);
+  return ok;
+}
@@ -0,0 +1,55 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "game.h"
+
+typedef struct replay Replay;
+typedef struct keyframe Keyframe;
+
+/* A state serialized with serialize_game_state */
+struct keyframe {
+  unsigned char *data;
+  size_t size;
+};
+
+/* A recorded game: the name of the game, the seed of the deal, the move log
+ * and keyframes. Keyframe i is the state after the first
+ * (i + 1) * keyframe_interval records. */
+struct replay {
+  char *game;
+  uint32_t seed;
+  LogRecord *records;
+  int size;
+  int keyframe_interval;
+  int keyframe_count;
+  Keyframe *keyframes;
+};
+
+extern int replays_enabled;
+extern char *replay_dir_path;
+
+int touch_replay_dir(const char *arg0);
+
+int save_replay(const char *path, Game *game, uint32_t seed, GameState *state);
+int archive_replay(Game *game, uint32_t seed, GameState *state);
+Replay *load_replay(const char *path);
+void delete_replay(Replay *replay);
+
+/* Returns the state after the first `to` records of a replay. `state` is
+ * either NULL or a state returned by seek_replay for position `from`. It is
+ * reused when seeking forward within a keyframe interval, otherwise `arena`
+ * is cleared and the nearest keyframe is restored. Returns NULL if the replay
+ * is invalid. */
+GameState *seek_replay(Arena *arena, Game *game, Replay *replay, GameState *state, int from, int to);
+
+/* Plays the moves of a replay without a user interface and prints the
+ * outcome */
+int replay_main(Game *game, Replay *replay);
+
+#endif
@@ -0,0 +1,49 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#include "rng.h"
+
+static uint32_t rotl(uint32_t x, int k) {
+  return (x << k) | (x >> (32 - k));
+}
+
+static uint32_t splitmix32(uint32_t *x) {
+  uint32_t z = (*x += UINT32_C(0x9E3779B9));
+  z = (z ^ (z >> 16)) * UINT32_C(0x21F0AAAD);
+  z = (z ^ (z >> 15)) * UINT32_C(0x735A2D97);
+  return z ^ (z >> 15);
+}
+
+void rng_seed(Rng *rng, uint32_t seed) {
+  int i;
+  for (i = 0; i < 4; i++) {
+    rng->s[i] = splitmix32(&seed);
+  }
+}
+
+uint32_t rng_next(Rng *rng) {
+  uint32_t *s = rng->s;
+  uint32_t result = rotl(s[1] * 5, 7) * 9;
+  uint32_t t = s[1] << 9;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 11);
+  return result;
+}
+
+uint32_t rng_range(Rng *rng, uint32_t n) {
+  /* Reject the values that would make the modulo biased */
+  uint32_t threshold = (UINT32_C(0) - n) % n;
+  while (1) {
+    uint32_t r = rng_next(rng);
+    if (r >= threshold) {
+      return r % n;
+    }
+  }
+}
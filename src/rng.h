@@ -0,0 +1,24 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <inttypes.h>
+
+typedef struct rng Rng;
+
+/* xoshiro128** state. Only 32-bit arithmetic is used, so a given seed
+ * produces the same sequence on every platform, including DOS. */
+struct rng {
+  uint32_t s[4];
+};
+
+void rng_seed(Rng *rng, uint32_t seed);
+uint32_t rng_next(Rng *rng);
+uint32_t rng_range(Rng *rng, uint32_t n);
+
+#endif
@@ -0,0 +1,161 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#define _XOPEN_SOURCE 500
+
+#include "save.h"
+
+#include "error.h"
+#include "util.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Saved games start with this signature followed by a version byte, the seed
+ * and the time spent, and then the serialized GameState. All numbers are
+ * little-endian. */
+#define SAVE_SIGNATURE "CSS"
+#define SAVE_VERSION 1
+#define SAVE_HEADER_SIZE 12
+
+int autosave_enabled = 0;
+char *save_dir_path = NULL;
+
+int touch_save_dir(const char *arg0) {
+  if (!autosave_enabled) {
+    return 1;
+  }
+  if (!save_dir_path) {
+    save_dir_path = find_data_file("saves", arg0);
+  }
+  if (!save_dir_path) {
+    printf("Could not find a place to put saved games\n");
+    return 0;
+  }
+  return mkdir_rec(save_dir_path);
+}
+
+static char *get_save_path(const char *game_name) {
+  char *file_name, *path;
+  if (!save_dir_path) {
+    return NULL;
+  }
+  file_name = malloc(strlen(game_name) + 5);
+  sprintf(file_name, "%s.sav", game_name);
+  path = combine_paths(save_dir_path, file_name);
+  free(file_name);
+  return path;
+}
+
+static char *add_extension(const char *path, const char *extension) {
+  char *result = malloc(strlen(path) + strlen(extension) + 1);
+  sprintf(result, "%s%s", path, extension);
+  return result;
+}
+
+/* rename() does not replace an existing file on every platform */
+static int replace_file(const char *from, const char *to) {
+  if (rename(from, to) == 0) {
+    return 1;
+  }
+  remove(to);
+  return rename(from, to) == 0;
+}
+
+static void put_uint32(unsigned char *p, uint32_t value) {
+  p[0] = value & 0xFF;
+  p[1] = value >> 8 & 0xFF;
+  p[2] = value >> 16 & 0xFF;
+  p[3] = value >> 24 & 0xFF;
+}
+
+static uint32_t get_uint32(const unsigned char *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/* The game is written to a temporary file first so that the previous save
+ * survives a failed write. */
+int save_game(const char *game_name, uint32_t seed, int32_t duration, GameState *state) {
+  unsigned char header[SAVE_HEADER_SIZE];
+  unsigned char *data;
+  size_t size;
+  int ok;
+  FILE *f;
+  char *tmp_path;
+  char *path = get_save_path(game_name);
+  if (!autosave_enabled || !path) {
+    free(path);
+    return 0;
+  }
+  tmp_path = add_extension(path, ".tmp");
+  f = fopen(tmp_path, "wb");
+  if (!f) {
+    print_error("Saving game failed: %s: %s", tmp_path, strerror(errno));
+    free(tmp_path);
+    free(path);
+    return 0;
+  }
+  memcpy(header, SAVE_SIGNATURE, 3);
+  header[3] = SAVE_VERSION;
+  put_uint32(header + 4, seed);
+  put_uint32(header + 8, (uint32_t)duration);
+  data = serialize_game_state(state, 0, &size);
+  ok = fwrite(header, 1, SAVE_HEADER_SIZE, f) == SAVE_HEADER_SIZE && fwrite(data, 1, size, f) == size;
+  free(data);
+  ok = !ferror(f) && ok;
+  ok = fclose(f) == 0 && ok;
+  if (ok) {
+    ok = replace_file(tmp_path, path);
+  }
+  if (!ok) {
+    print_error("Saving game failed: %s: %s", path, strerror(errno));
+    remove(tmp_path);
+  }
+  free(tmp_path);
+  free(path);
+  return ok;
+}
+
+/* The whole file is read at once into memory allocated from the arena. A
+ * file that cannot be loaded is renamed so that it is not tried again. */
+GameState *resume_game(Arena *arena, Game *game, uint32_t *seed, int32_t *duration) {
+  GameState *state = NULL;
+  unsigned char *data;
+  long size;
+  FILE *f;
+  char *path = get_save_path(game->name);
+  if (!autosave_enabled || !path) {
+    free(path);
+    return NULL;
+  }
+  f = fopen(path, "rb");
+  if (!f) {
+    free(path);
+    return NULL;
+  }
+  if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) >= SAVE_HEADER_SIZE && fseek(f, 0, SEEK_SET) == 0) {
+    data = arena_alloc(arena, size);
+    if (fread(data, 1, size, f) == (size_t)size && memcmp(data, SAVE_SIGNATURE, 3) == 0
+        && data[3] == SAVE_VERSION) {
+      *seed = get_uint32(data + 4);
+      *duration = (int32_t)get_uint32(data + 8);
+      state = deserialize_game_state(arena, game, data + SAVE_HEADER_SIZE, size - SAVE_HEADER_SIZE);
+    }
+  }
+  fclose(f);
+  if (state) {
+    remove(path);
+  } else {
+    char *bad_path = add_extension(path, ".bad");
+    print_error("Saved game could not be loaded, moved to %s", bad_path);
+    replace_file(path, bad_path);
+    free(bad_path);
+  }
+  free(path);
+  return state;
+}
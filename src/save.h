@@ -0,0 +1,25 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#ifndef SAVE_H
+#define SAVE_H
+
+#include "game.h"
+
+extern int autosave_enabled;
+extern char *save_dir_path;
+
+int touch_save_dir(const char *arg0);
+
+/* Saves a game in progress so that it can be resumed the next time the game
+ * is started. */
+int save_game(const char *game_name, uint32_t seed, int32_t duration, GameState *state);
+
+/* Loads and deletes the saved game for `game`. Returns NULL if there is no
+ * saved game. */
+GameState *resume_game(Arena *arena, Game *game, uint32_t *seed, int32_t *duration);
+
+#endif
@@ -0,0 +1,224 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#include "screen.h"
+
+#include "color.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Number of cells converted by screen_print before they are passed on */
+#define PRINT_BUFFER_SIZE 64
+
+typedef struct {
+  Screen screen;
+  /* The cells as drawn and as last flushed to the (imagined) terminal */
+  Cell *cells;
+  Cell *shown;
+} MemoryScreen;
+
+static const Cell blank = {' ', COLOR_PAIR_BACKGROUND, 0};
+
+static void memory_put(Screen *screen, int y, int x, const Cell *cells, int n) {
+  MemoryScreen *memory = (MemoryScreen *)screen;
+  memcpy(memory->cells + y * screen->width + x, cells, n * sizeof(Cell));
+}
+
+static void memory_erase(Screen *screen) {
+  MemoryScreen *memory = (MemoryScreen *)screen;
+  int i;
+  for (i = 0; i < screen->width * screen->height; i++) {
+    memory->cells[i] = blank;
+  }
+}
+
+/* A screen that only exists in memory. It is used to render card glyphs and
+ * to measure drawing without a terminal. */
+Screen *new_memory_screen(int width, int height, int utf8) {
+  MemoryScreen *memory = malloc(sizeof(MemoryScreen));
+  int i;
+  memory->screen.width = width;
+  memory->screen.height = height;
+  memory->screen.utf8 = utf8;
+  memory->screen.pair = COLOR_PAIR_BACKGROUND;
+  memory->screen.attr = 0;
+  memory->screen.put = memory_put;
+  memory->screen.erase = memory_erase;
+  memory->cells = malloc(width * height * sizeof(Cell));
+  memory->shown = malloc(width * height * sizeof(Cell));
+  memory_erase(&memory->screen);
+  for (i = 0; i < width * height; i++) {
+    memory->shown[i] = blank;
+  }
+  return &memory->screen;
+}
+
+void delete_memory_screen(Screen *screen) {
+  MemoryScreen *memory = (MemoryScreen *)screen;
+  free(memory->cells);
+  free(memory->shown);
+  free(memory);
+}
+
+const Cell *get_screen_row(Screen *screen, int y) {
+  return ((MemoryScreen *)screen)->cells + y * screen->width;
+}
+
+static int same_cell(Cell a, Cell b) {
+  return a.ch == b.ch && a.pair == b.pair && a.attr == b.attr;
+}
+
+static int count_digits(int n) {
+  int digits = 1;
+  while (n >= 10) {
+    n /= 10;
+    digits++;
+  }
+  return digits;
+}
+
+static int utf8_length(uint32_t ch) {
+  if (ch < 0x80) {
+    return 1;
+  } else if (ch < 0x800) {
+    return 2;
+  } else if (ch < 0x10000) {
+    return 3;
+  }
+  return 4;
+}
+
+/* Returns the number of bytes an ANSI terminal would have to receive to show
+ * the changes made since the last flush: a cursor movement ("ESC[y;xH") before
+ * every run of changed cells, an SGR sequence ("ESC[0;7;1;3f;4bm") whenever the
+ * attributes change, and the characters themselves. */
+long flush_memory_screen(Screen *screen) {
+  MemoryScreen *memory = (MemoryScreen *)screen;
+  Cell current = blank;
+  long bytes = 0;
+  int y, x, cursor = -1;
+  current.pair = 0;
+  for (y = 0; y < screen->height; y++) {
+    for (x = 0; x < screen->width; x++) {
+      int i = y * screen->width + x;
+      Cell cell = memory->cells[i];
+      if (same_cell(cell, memory->shown[i])) {
+        continue;
+      }
+      if (cursor != i) {
+        bytes += 4 + count_digits(y + 1) + count_digits(x + 1);
+      }
+      if (cell.pair != current.pair || cell.attr != current.attr) {
+        bytes += 4 + 6 * !!cell.pair + 2 * !!(cell.attr & SCREEN_REVERSE) + 2 * !!(cell.attr & SCREEN_BOLD);
+        current = cell;
+      }
+      bytes += screen->utf8 ? utf8_length(cell.ch) : 1;
+      memory->shown[i] = cell;
+      cursor = i + 1;
+    }
+  }
+  return bytes;
+}
+
+/* Decodes the next character of a string. Bytes that aren't part of a valid
+ * UTF-8 sequence are returned as they are. */
+static uint32_t next_char(Screen *screen, const unsigned char **text) {
+  const unsigned char *s = *text;
+  uint32_t ch = *s++;
+  int length = 0, i;
+  if (screen->utf8) {
+    if ((ch & 0xE0) == 0xC0) {
+      length = 1;
+      ch &= 0x1F;
+    } else if ((ch & 0xF0) == 0xE0) {
+      length = 2;
+      ch &= 0x0F;
+    } else if ((ch & 0xF8) == 0xF0) {
+      length = 3;
+      ch &= 0x07;
+    }
+    for (i = 0; i < length; i++) {
+      if ((s[i] & 0xC0) != 0x80) {
+        ch = **text;
+        length = 0;
+        break;
+      }
+      ch = (ch << 6) | (s[i] & 0x3F);
+    }
+  }
+  *text = s + length;
+  return ch;
+}
+
+/* The number of columns used by a string, assuming one column per
+ * character */
+int text_width(Screen *screen, const char *text) {
+  const unsigned char *s = (const unsigned char *)text;
+  int width = 0;
+  while (*s) {
+    next_char(screen, &s);
+    width++;
+  }
+  return width;
+}
+
+/* Prints a string with the current color pair and attributes. Returns the
+ * column after the last character, even if the string was clipped. */
+int screen_print(Screen *screen, int y, int x, const char *text) {
+  const unsigned char *s = (const unsigned char *)text;
+  Cell buffer[PRINT_BUFFER_SIZE];
+  int start = x, n = 0;
+  while (*s) {
+    buffer[n].ch = next_char(screen, &s);
+    buffer[n].pair = screen->pair;
+    buffer[n].attr = screen->attr;
+    n++;
+    if (n == PRINT_BUFFER_SIZE || !*s) {
+      screen_put(screen, y, start, buffer, n);
+      start += n;
+      n = 0;
+    }
+  }
+  return start;
+}
+
+void screen_put(Screen *screen, int y, int x, const Cell *cells, int n) {
+  if (y < 0 || y >= screen->height || x >= screen->width) {
+    return;
+  }
+  if (x < 0) {
+    cells -= x;
+    n += x;
+    x = 0;
+  }
+  if (x + n > screen->width) {
+    n = screen->width - x;
+  }
+  if (n > 0) {
+    screen->put(screen, y, x, cells, n);
+  }
+}
+
+/* Prints `n` blank cells in the current color pair */
+void screen_fill(Screen *screen, int y, int x, int n) {
+  Cell buffer[PRINT_BUFFER_SIZE];
+  int i;
+  for (i = 0; i < n && i < PRINT_BUFFER_SIZE; i++) {
+    buffer[i].ch = ' ';
+    buffer[i].pair = screen->pair;
+    buffer[i].attr = screen->attr;
+  }
+  while (n > 0) {
+    screen_put(screen, y, x, buffer, n < PRINT_BUFFER_SIZE ? n : PRINT_BUFFER_SIZE);
+    x += PRINT_BUFFER_SIZE;
+    n -= PRINT_BUFFER_SIZE;
+  }
+}
+
+void screen_erase(Screen *screen) {
+  screen->erase(screen);
+}
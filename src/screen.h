@@ -0,0 +1,51 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include <inttypes.h>
+
+#define SCREEN_REVERSE 0x01
+#define SCREEN_BOLD 0x02
+
+typedef struct screen Screen;
+
+/* A character cell. `ch` is a Unicode code point on UTF-8 screens and a byte
+ * otherwise, `pair` is one of the COLOR_PAIR_* constants. */
+typedef struct {
+  uint32_t ch;
+  unsigned char pair;
+  unsigned char attr;
+} Cell;
+
+/* A grid of cells that the user interface draws on. The drawing functions
+ * below clip to `width` and `height` before calling the backend. */
+struct screen {
+  int width;
+  int height;
+  int utf8;
+  /* Color pair and attributes of printed text */
+  unsigned char pair;
+  unsigned char attr;
+  /* Writes `n` cells starting at (`y`, `x`), all of them within the screen */
+  void (*put)(Screen *screen, int y, int x, const Cell *cells, int n);
+  /* Fills the screen with blank background cells */
+  void (*erase)(Screen *screen);
+};
+
+Screen *new_memory_screen(int width, int height, int utf8);
+void delete_memory_screen(Screen *screen);
+const Cell *get_screen_row(Screen *screen, int y);
+long flush_memory_screen(Screen *screen);
+
+int text_width(Screen *screen, const char *text);
+int screen_print(Screen *screen, int y, int x, const char *text);
+void screen_put(Screen *screen, int y, int x, const Cell *cells, int n);
+void screen_fill(Screen *screen, int y, int x, int n);
+void screen_erase(Screen *screen);
+
+#endif
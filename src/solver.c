@@ -0,0 +1,613 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#include "solver.h"
+
+#include "util.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_TABLE_SIZE 4096
+#define INITIAL_NODES 1024
+
+/* Number of nodes expanded between checks of the time limit */
+#define CLOCK_INTERVAL 16
+
+/* Memory that the solver may use when looking for a hint */
+#define HINT_MEMORY (32ul * 1024 * 1024)
+
+/* The part of the hint time, 1/HINT_FALLBACK, that is left for picking a move
+ * with heuristic_move when the solver runs out of time */
+#define HINT_FALLBACK 4
+
+/* Number of recent positions that hints try not to return to */
+#define HINT_HISTORY 8
+
+/* Penalty for a hint that returns to a recent position */
+#define HINT_REPEAT_PENALTY 10000
+
+typedef struct solver Solver;
+typedef struct node Node;
+typedef struct open_node OpenNode;
+
+/* A position in the search tree, reached by playing `move` in the parent
+ * position. */
+struct node {
+  int parent;
+  int depth;
+  Move move;
+};
+
+struct open_node {
+  int priority;
+  int node;
+};
+
+struct solver {
+  GameState *state;
+  long max_nodes;
+  long nodes;
+  unsigned long max_memory;
+  /* The search stops when `max_ms` milliseconds have passed since `start`, if
+   * `max_ms` is positive */
+  long max_ms;
+  unsigned long start;
+  /* Transposition table: open addressing set of position hashes */
+  uint64_t *table;
+  size_t table_size;
+  size_t table_used;
+  Node *tree;
+  int tree_size;
+  int tree_capacity;
+  /* Binary heap of unexpanded nodes, best first */
+  OpenNode *open;
+  int open_size;
+  int open_capacity;
+  /* The node the board is currently in */
+  int current;
+  MoveList *moves;
+  Move *path;
+  int path_capacity;
+};
+
+static const char *rule_names[] = {
+  "none", "any", "tableau", "stock", "foundation", "cell", "waste"
+};
+
+static unsigned long memory_used(Solver *s) {
+  return s->table_size * sizeof(uint64_t) + s->tree_capacity * sizeof(Node)
+    + s->open_capacity * sizeof(OpenNode);
+}
+
+static void table_put(uint64_t *table, size_t size, uint64_t hash) {
+  size_t i = (size_t)hash & (size - 1);
+  while (table[i] && table[i] != hash) {
+    i = (i + 1) & (size - 1);
+  }
+  table[i] = hash;
+}
+
+static int grow_table(Solver *s) {
+  size_t i, size = s->table_size * 2;
+  uint64_t *table;
+  if (memory_used(s) + s->table_size * sizeof(uint64_t) > s->max_memory) {
+    return 0;
+  }
+  table = calloc(size, sizeof(uint64_t));
+  if (!table) {
+    return 0;
+  }
+  for (i = 0; i < s->table_size; i++) {
+    if (s->table[i]) {
+      table_put(table, size, s->table[i]);
+    }
+  }
+  free(s->table);
+  s->table = table;
+  s->table_size = size;
+  return 1;
+}
+
+/* Adds a position to the transposition table. Returns 1 if the position is
+ * new, 0 if it has been seen before, and -1 if the table is full. */
+static int visit(Solver *s, uint64_t hash) {
+  size_t i;
+  if (!hash) {
+    hash = 1;
+  }
+  if ((s->table_used + 1) * 4 > s->table_size * 3 && !grow_table(s)) {
+    return -1;
+  }
+  i = (size_t)hash & (s->table_size - 1);
+  while (s->table[i]) {
+    if (s->table[i] == hash) {
+      return 0;
+    }
+    i = (i + 1) & (s->table_size - 1);
+  }
+  s->table[i] = hash;
+  s->table_used++;
+  return 1;
+}
+
+static int same_rules(GameRule *a, GameRule *b) {
+  return a->type == b->type && a->first_cards[0] == b->first_cards[0]
+    && a->first_cards[1] == b->first_cards[1] && a->next_cards == b->next_cards
+    && a->move_group == b->move_group && a->from == b->from && a->class == b->class;
+}
+
+/* Moves to an empty pile are only tried for the first of several empty piles
+ * that accept the same cards, and moving an entire pile to an equivalent
+ * empty pile is never tried. */
+static int is_redundant(Move *move, Pile *piles) {
+  Pile *dest, *src, *p;
+  if (move->type != MOVE_STACK) {
+    return 0;
+  }
+  dest = get_pile(piles, move->dest);
+  if (NOT_BOTTOM(get_top(dest->stack))) {
+    return 0;
+  }
+  src = get_pile(piles, move->src);
+  if (src->stack->stack->size - 1 == move->count && same_rules(src->rule, dest->rule)) {
+    return 1;
+  }
+  for (p = piles; p != dest; p = p->next) {
+    if (p != src && IS_BOTTOM(get_top(p->stack)) && same_rules(p->rule, dest->rule)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Scores a position: cards that count towards winning count for, and cards
+ * that are face down or out of sequence count against. */
+static int evaluate(Pile *piles) {
+  Pile *pile;
+  int score = 0;
+  for (pile = piles; pile; pile = pile->next) {
+    Stack *stack = pile->stack->stack;
+    int i, base = pile->stack->index;
+    int cards = stack->size - base - 1;
+    if (pile->rule->win_rank == RANK_EMPTY) {
+      score -= 100 * cards;
+    } else if (pile->rule->win_rank != RANK_NONE) {
+      score += 100 * cards;
+    }
+    if (pile->rule->type == RULE_CELL) {
+      score -= 10 * cards;
+    } else if (pile->rule->type == RULE_TABLEAU) {
+      if (!cards) {
+        score += 20;
+      }
+      for (i = base + 1; i < stack->size; i++) {
+        if (!stack->cards[i]->up) {
+          score -= 15;
+        } else if (i > base + 1 && !check_next(stack->cards[i], stack->cards[i - 1], pile->rule)) {
+          score -= 5 * (stack->size - i);
+        }
+      }
+    }
+  }
+  return score;
+}
+
+/* Plays the moves needed to get from the current node to `target`: undo
+ * back to their common ancestor, then replay down to the target. */
+static void goto_node(Solver *s, int target) {
+  int a = s->current, b = target, length = 0;
+  while (s->tree[a].depth > s->tree[b].depth) {
+    undo_move(s->state);
+    a = s->tree[a].parent;
+  }
+  while (s->tree[b].depth > s->tree[a].depth) {
+    s->path[length++] = s->tree[b].move;
+    b = s->tree[b].parent;
+  }
+  while (a != b) {
+    undo_move(s->state);
+    a = s->tree[a].parent;
+    s->path[length++] = s->tree[b].move;
+    b = s->tree[b].parent;
+  }
+  while (length > 0) {
+    play_move(s->state, s->path[--length]);
+  }
+  s->current = target;
+}
+
+static int add_node(Solver *s, int parent, Move move) {
+  Node *node;
+  if (s->tree_size >= s->tree_capacity) {
+    if (memory_used(s) + s->tree_capacity * sizeof(Node) > s->max_memory) {
+      return -1;
+    }
+    s->tree_capacity *= 2;
+    s->tree = realloc(s->tree, s->tree_capacity * sizeof(Node));
+  }
+  node = &s->tree[s->tree_size];
+  node->parent = parent;
+  node->depth = parent < 0 ? 0 : s->tree[parent].depth + 1;
+  node->move = move;
+  if (node->depth >= s->path_capacity) {
+    s->path_capacity *= 2;
+    s->path = realloc(s->path, s->path_capacity * sizeof(Move));
+  }
+  return s->tree_size++;
+}
+
+static int push_open(Solver *s, int node, int priority) {
+  int i;
+  if (s->open_size >= s->open_capacity) {
+    if (memory_used(s) + s->open_capacity * sizeof(OpenNode) > s->max_memory) {
+      return 0;
+    }
+    s->open_capacity *= 2;
+    s->open = realloc(s->open, s->open_capacity * sizeof(OpenNode));
+  }
+  for (i = s->open_size++; i > 0 && s->open[(i - 1) / 2].priority < priority; i = (i - 1) / 2) {
+    s->open[i] = s->open[(i - 1) / 2];
+  }
+  s->open[i].priority = priority;
+  s->open[i].node = node;
+  return 1;
+}
+
+static int pop_open(Solver *s) {
+  int i = 0, node = s->open[0].node;
+  OpenNode last = s->open[--s->open_size];
+  while (2 * i + 1 < s->open_size) {
+    int child = 2 * i + 1;
+    if (child + 1 < s->open_size && s->open[child + 1].priority > s->open[child].priority) {
+      child++;
+    }
+    if (s->open[child].priority <= last.priority) {
+      break;
+    }
+    s->open[i] = s->open[child];
+    i = child;
+  }
+  s->open[i] = last;
+  return node;
+}
+
+/* Plays every move from the current node and queues the positions that have
+ * not been seen before. Returns the node of a winning position if one is
+ * found, -1 if none is, or -2 if memory runs out. */
+static int expand(Solver *s) {
+  int i, parent = s->current;
+  Pile *piles = s->state->piles;
+  generate_moves(piles, s->moves);
+  for (i = 0; i < s->moves->size; i++) {
+    Move move = s->moves->moves[i];
+    int visited, node;
+    if (is_redundant(&move, piles) || !play_move(s->state, move)) {
+      continue;
+    }
+    visited = visit(s, s->state->hash);
+    if (visited > 0) {
+      node = add_node(s, parent, move);
+      if (node < 0) {
+        visited = -1;
+      } else if (check_win_condition(piles)) {
+        s->current = node;
+        return node;
+      } else if (!push_open(s, node, evaluate(piles) - s->tree[node].depth)) {
+        visited = -1;
+      }
+    }
+    undo_move(s->state);
+    if (visited < 0) {
+      return -2;
+    }
+  }
+  return -1;
+}
+
+static SolveResult search(Solver *s) {
+  Move none = {MOVE_STACK, 0, 0, 0};
+  s->current = add_node(s, -1, none);
+  if (check_win_condition(s->state->piles)) {
+    return SOLVE_WON;
+  }
+  visit(s, s->state->hash);
+  push_open(s, s->current, 0);
+  while (s->open_size > 0) {
+    int result;
+    if (s->nodes >= s->max_nodes) {
+      return SOLVE_NODE_LIMIT;
+    }
+    if (s->max_ms > 0 && s->nodes % CLOCK_INTERVAL == 0
+        && get_milliseconds() - s->start >= (unsigned long)s->max_ms) {
+      return SOLVE_TIME_LIMIT;
+    }
+    goto_node(s, pop_open(s));
+    s->nodes++;
+    result = expand(s);
+    if (result >= 0) {
+      return SOLVE_WON;
+    } else if (result == -2) {
+      return SOLVE_MEMORY_LIMIT;
+    }
+  }
+  return SOLVE_LOST;
+}
+
+/* Searches for a solution, for at most `max_ms` milliseconds if `max_ms` is
+ * positive */
+static SolveResult run_solver(GameState *state, long max_nodes, unsigned long max_memory, long max_ms,
+    Solution *solution) {
+  Solver s;
+  Snapshot *snapshot = new_snapshot(state);
+  int log_moves = state->log_moves;
+  state->log_moves = 0;
+  s.state = state;
+  s.max_nodes = max_nodes;
+  s.nodes = 0;
+  s.max_memory = max_memory;
+  s.max_ms = max_ms;
+  s.start = get_milliseconds();
+  s.table_size = INITIAL_TABLE_SIZE;
+  s.table_used = 0;
+  s.table = calloc(s.table_size, sizeof(uint64_t));
+  s.tree_size = 0;
+  s.tree_capacity = INITIAL_NODES;
+  s.tree = malloc(s.tree_capacity * sizeof(Node));
+  s.open_size = 0;
+  s.open_capacity = INITIAL_NODES;
+  s.open = malloc(s.open_capacity * sizeof(OpenNode));
+  s.moves = new_move_list();
+  s.path_capacity = 64;
+  s.path = malloc(s.path_capacity * sizeof(Move));
+  solution->result = search(&s);
+  solution->nodes = s.nodes;
+  solution->length = 0;
+  solution->moves = NULL;
+  if (solution->result == SOLVE_WON) {
+    int node = s.current;
+    solution->length = s.tree[node].depth;
+    solution->moves = malloc((solution->length + 1) * sizeof(Move));
+    for (; s.tree[node].parent >= 0; node = s.tree[node].parent) {
+      solution->moves[s.tree[node].depth - 1] = s.tree[node].move;
+    }
+  }
+  state_restore(state, snapshot);
+  state->log_moves = log_moves;
+  delete_snapshot(snapshot);
+  delete_move_list(s.moves);
+  free(s.path);
+  free(s.open);
+  free(s.tree);
+  free(s.table);
+  return solution->result;
+}
+
+SolveResult solve(GameState *state, long max_nodes, unsigned long max_memory, Solution *solution) {
+  return run_solver(state, max_nodes, max_memory, 0, solution);
+}
+
+void delete_solution(Solution *solution) {
+  free(solution->moves);
+  solution->moves = NULL;
+  solution->length = 0;
+}
+
+int has_hidden_cards(Pile *piles) {
+  Pile *pile;
+  for (pile = piles; pile; pile = pile->next) {
+    if (pile->rule->type != RULE_STOCK) {
+      Stack *stack = pile->stack->stack;
+      int i;
+      for (i = pile->stack->index + 1; i < stack->size; i++) {
+        if (!stack->cards[i]->up) {
+          return 1;
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+/* Unlike has_hidden_cards this includes the stock */
+static int has_face_down_cards(Pile *piles) {
+  Pile *pile;
+  for (pile = piles; pile; pile = pile->next) {
+    Stack *stack = pile->stack->stack;
+    int i;
+    for (i = pile->stack->index + 1; i < stack->size; i++) {
+      if (!stack->cards[i]->up) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+/* Picks the move that leads to the best position according to evaluate.
+ * Moves that leave a face-down card on top of their source pile get a bonus,
+ * since the card can be turned next. Moves back to one of the `recent`
+ * positions are only picked if there is nothing else. */
+static int heuristic_move(GameState *state, uint64_t *recent, int recent_count, Move *hint) {
+  MoveList *list = new_move_list();
+  int i, found = 0, best = 0;
+  generate_moves(state->piles, list);
+  for (i = 0; i < list->size; i++) {
+    Move move = list->moves[i];
+    Pile *src = get_pile(state->piles, move.src);
+    Card *top;
+    int j, score;
+    if (is_redundant(&move, state->piles) || !play_move(state, move)) {
+      continue;
+    }
+    score = evaluate(state->piles);
+    for (j = 0; j < recent_count; j++) {
+      if (recent[j] == state->hash) {
+        score -= HINT_REPEAT_PENALTY;
+        break;
+      }
+    }
+    top = get_top(src->stack);
+    if (move.type == MOVE_STACK && NOT_BOTTOM(top) && !top->up) {
+      score += 10;
+    }
+    undo_move(state);
+    if (!found || score > best) {
+      *hint = move;
+      best = score;
+      found = 1;
+    }
+  }
+  delete_move_list(list);
+  return found;
+}
+
+HintResult find_hint(Game *game, GameState *state, long max_ms, Move *hint) {
+  Arena *arena;
+  GameState *copy;
+  unsigned char *data;
+  size_t size;
+  uint64_t recent[HINT_HISTORY];
+  int i, recent_count = 0;
+  HintResult found = HINT_NONE;
+  if (check_win_condition(state->piles)) {
+    return HINT_NONE;
+  }
+  data = serialize_game_state(state, HINT_HISTORY, &size);
+  arena = new_arena(DEAL_ARENA_SIZE);
+  copy = deserialize_game_state(arena, game, data, size);
+  free(data);
+  if (copy) {
+    if (!has_face_down_cards(copy->piles)) {
+      Solution solution;
+      if (run_solver(copy, LONG_MAX, HINT_MEMORY, max_ms - max_ms / HINT_FALLBACK, &solution)
+          == SOLVE_WON) {
+        *hint = solution.moves[0];
+        found = HINT_SOLUTION;
+      }
+      delete_solution(&solution);
+    }
+    if (!found) {
+      while (recent_count < HINT_HISTORY && undo_move(copy)) {
+        recent[recent_count++] = copy->hash;
+      }
+      for (i = 0; i < recent_count; i++) {
+        redo_move(copy);
+      }
+      if (heuristic_move(copy, recent, recent_count, hint)) {
+        found = HINT_GUESS;
+      }
+    }
+  }
+  delete_arena(arena);
+  return found;
+}
+
+static void print_card(FILE *f, Card *card) {
+  static const char *ranks[] = {
+    "?", "A", "2", "3", "4", "5", "6", "7", "8", "9", "10", "J", "Q", "K"
+  };
+  char suit = '?';
+  switch (card->suit) {
+    case HEART: suit = 'h'; break;
+    case DIAMOND: suit = 'd'; break;
+    case SPADE: suit = 's'; break;
+    case CLUB: suit = 'c'; break;
+  }
+  fprintf(f, "%s%c", ranks[card->rank >= ACE && card->rank <= KING ? card->rank : 0], suit);
+}
+
+static void print_pile(FILE *f, Pile *pile, Pile *piles) {
+  Pile *p;
+  int n = 1;
+  for (p = piles; p != pile; p = p->next) {
+    if (p->rule->type == pile->rule->type) {
+      n++;
+    }
+  }
+  fprintf(f, "%s %d", rule_names[pile->rule->type], n);
+}
+
+/* Prints a description of a move that is about to be played. */
+void print_move(FILE *f, Move move, Pile *piles) {
+  Pile *src = get_pile(piles, move.src);
+  Stack *stack = src->stack->stack;
+  switch (move.type) {
+    case MOVE_STACK:
+      print_card(f, stack->cards[stack->size - move.count]);
+      if (move.count > 1) {
+        fprintf(f, " (%d cards)", move.count);
+      }
+      fprintf(f, " from ");
+      print_pile(f, src, piles);
+      fprintf(f, " to ");
+      print_pile(f, get_pile(piles, move.dest), piles);
+      break;
+    case MOVE_TURN_CARD:
+      fprintf(f, "turn card on ");
+      print_pile(f, src, piles);
+      break;
+    case MOVE_TURN_STOCK:
+      fprintf(f, "deal from ");
+      print_pile(f, src, piles);
+      break;
+    case MOVE_REDEAL:
+      fprintf(f, "redeal ");
+      print_pile(f, src, piles);
+      break;
+  }
+}
+
+int solve_main(Game *game, unsigned int seed, long max_nodes, unsigned long max_memory) {
+  Arena *arena = new_arena(DEAL_ARENA_SIZE);
+  Card *deck;
+  GameState *state;
+  Rng rng;
+  Solution solution;
+  unsigned long start;
+  long ms;
+  int i;
+  rng_seed(&rng, seed);
+  deck = new_deck(arena, game->decks, game->deck_suits);
+  shuffle_stack(next_card(deck), &rng);
+  state = new_game_state(arena, game, deck);
+  if (has_hidden_cards(state->piles)) {
+    printf("warning: %s deals face-down cards, solving with all cards known\n", game->name);
+  }
+  start = get_milliseconds();
+  solve(state, max_nodes, max_memory, &solution);
+  ms = (long)(get_milliseconds() - start);
+  switch (solution.result) {
+    case SOLVE_WON:
+      printf("%s #%u: solved in %d moves\n", game->name, seed, solution.length);
+      for (i = 0; i < solution.length; i++) {
+        printf("%4d. ", i + 1);
+        print_move(stdout, solution.moves[i], state->piles);
+        printf("\n");
+        play_move(state, solution.moves[i]);
+      }
+      break;
+    case SOLVE_LOST:
+      printf("%s #%u: no solution\n", game->name, seed);
+      break;
+    case SOLVE_NODE_LIMIT:
+      printf("%s #%u: node limit reached\n", game->name, seed);
+      break;
+    case SOLVE_MEMORY_LIMIT:
+      printf("%s #%u: memory limit reached\n", game->name, seed);
+      break;
+    case SOLVE_TIME_LIMIT:
+      printf("%s #%u: time limit reached\n", game->name, seed);
+      break;
+    default:
+      break;
+  }
+  printf("nodes: %ld, time: %ld ms\n", solution.nodes, ms);
+  delete_solution(&solution);
+  delete_arena(arena);
+  return solution.result == SOLVE_WON;
+}
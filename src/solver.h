@@ -0,0 +1,60 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include "game.h"
+
+#include <stdio.h>
+
+typedef struct solution Solution;
+typedef enum {
+  SOLVE_WON,
+  SOLVE_LOST,
+  SOLVE_NODE_LIMIT,
+  SOLVE_MEMORY_LIMIT,
+  SOLVE_TIME_LIMIT,
+  /* Number of results, not a result */
+  SOLVE_RESULT_COUNT
+} SolveResult;
+
+typedef enum {
+  HINT_NONE,
+  HINT_SOLUTION,
+  HINT_GUESS
+} HintResult;
+
+struct solution {
+  SolveResult result;
+  Move *moves;
+  int length;
+  long nodes;
+};
+
+/* Best-first search for a winning sequence of moves from the current
+ * position. The search stops after expanding `max_nodes` positions, or when it
+ * would need more than `max_memory` bytes. The board, score and move counter
+ * are restored before returning. */
+SolveResult solve(GameState *state, long max_nodes, unsigned long max_memory, Solution *solution);
+void delete_solution(Solution *solution);
+
+int has_hidden_cards(Pile *piles);
+
+/* Finds a good move in the current position without changing the state. If
+ * no card is face down, including in the stock, the solver is run for most of
+ * `max_ms` milliseconds and the first move of a solution is used
+ * (HINT_SOLUTION). Otherwise, or if no solution is found, the move is picked
+ * by scoring the positions one move ahead (HINT_GUESS). Returns HINT_NONE if
+ * there are no moves. */
+HintResult find_hint(Game *game, GameState *state, long max_ms, Move *hint);
+void print_move(FILE *f, Move move, Pile *piles);
+
+/* Deals the game with the given seed and prints a solution if one is found
+ * within the budget. */
+int solve_main(Game *game, unsigned int seed, long max_nodes, unsigned long max_memory);
+
+#endif
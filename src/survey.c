@@ -0,0 +1,333 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#define _XOPEN_SOURCE 500
+
+#include "survey.h"
+#include "solver.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(USE_PTHREADS) && !defined(NO_PTHREADS)
+#if defined(__unix__) || defined(__UNIX__) || defined(__linux__) || defined(__LINUX__)
+#define USE_PTHREADS
+#endif
+#endif
+
+#ifdef USE_PTHREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/* Largest number of seeds handed to a worker at a time */
+#define MAX_CHUNK 64
+
+/* Largest number of moves in a random playout */
+#define PLAYOUT_MOVE_CAP 1000
+
+typedef struct survey Survey;
+typedef struct survey_result SurveyResult;
+typedef struct survey_stats SurveyStats;
+typedef struct playout_stats PlayoutStats;
+
+struct survey_result {
+  uint32_t seed;
+  int32_t result;
+  int32_t nodes;
+  int32_t ms;
+};
+
+struct survey_stats {
+  long deals;
+  long results[SOLVE_RESULT_COUNT];
+  double nodes;
+  double ms;
+};
+
+struct playout_stats {
+  long playouts;
+  long wins;
+  long capped;
+  long invalid;
+  double moves;
+};
+
+/* Shared by all workers. `next` and `done` track the seeds that have not
+ * been handed out yet. If `playouts` is set, the deals are played with random
+ * moves instead of being solved. */
+struct survey {
+  Game *game;
+  long max_nodes;
+  unsigned long max_memory;
+  FILE *out;
+  SurveyStats stats;
+  int playouts;
+  PlayoutStats playout_stats;
+  unsigned int next;
+  unsigned int last;
+  int done;
+  int workers;
+#ifdef USE_PTHREADS
+  pthread_mutex_t lock;
+#endif
+};
+
+static const char *result_names[SOLVE_RESULT_COUNT] = {
+  "solved", "unsolved", "node-limit", "memory", "time"
+};
+
+/* Deals and solves a single game. Everything is allocated from the worker's
+ * arena, which is cleared before returning. */
+static SurveyResult survey_deal(Arena *arena, Game *game, unsigned int seed, long max_nodes,
+    unsigned long max_memory) {
+  SurveyResult result;
+  Card *deck;
+  GameState *state;
+  Rng rng;
+  Solution solution;
+  unsigned long start;
+  rng_seed(&rng, seed);
+  deck = new_deck(arena, game->decks, game->deck_suits);
+  shuffle_stack(next_card(deck), &rng);
+  state = new_game_state(arena, game, deck);
+  start = get_milliseconds();
+  solve(state, max_nodes, max_memory, &solution);
+  result.seed = seed;
+  result.result = solution.result;
+  result.nodes = solution.nodes;
+  result.ms = (int32_t)(get_milliseconds() - start);
+  delete_solution(&solution);
+  clear_arena(arena);
+  return result;
+}
+
+/* Deals a single game and plays uniformly random legal moves until the game
+ * is won, no moves are left, or PLAYOUT_MOVE_CAP moves have been made. The
+ * moves are chosen with the same generator that shuffled the deck. */
+static void playout_deal(Arena *arena, MoveList *list, Game *game, unsigned int seed, PlayoutStats *stats) {
+  Card *deck;
+  GameState *state;
+  Rng rng;
+  int moves = 0;
+  rng_seed(&rng, seed);
+  deck = new_deck(arena, game->decks, game->deck_suits);
+  shuffle_stack(next_card(deck), &rng);
+  state = new_game_state(arena, game, deck);
+  stats->playouts++;
+  while (1) {
+    int count;
+    if (check_win_condition(state->piles)) {
+      stats->wins++;
+      break;
+    }
+    if (moves >= PLAYOUT_MOVE_CAP) {
+      stats->capped++;
+      break;
+    }
+    count = generate_moves(state->piles, list);
+    if (!count) {
+      break;
+    }
+    if (!play_move(state, list->moves[rng_range(&rng, count)])) {
+      stats->invalid++;
+      break;
+    }
+    moves++;
+  }
+  stats->moves += moves;
+  clear_arena(arena);
+}
+
+static void add_playout_stats(PlayoutStats *total, PlayoutStats *stats) {
+  total->playouts += stats->playouts;
+  total->wins += stats->wins;
+  total->capped += stats->capped;
+  total->invalid += stats->invalid;
+  total->moves += stats->moves;
+  memset(stats, 0, sizeof(PlayoutStats));
+}
+
+static void report(FILE *out, SurveyResult *result, SurveyStats *stats) {
+  fprintf(out, "%" PRIu32 " %s %" PRId32 " %" PRId32 "\n", result->seed, result_names[result->result],
+      result->nodes, result->ms);
+  fflush(out);
+  stats->deals++;
+  stats->results[result->result]++;
+  stats->nodes += result->nodes;
+  stats->ms += result->ms;
+}
+
+/* Selects the next range of seeds to hand out. Chunks shrink as the survey
+ * nears its end so that a slow deal doesn't leave the other workers idle. */
+static int next_chunk(Survey *survey, uint32_t chunk[2]) {
+  unsigned long size;
+  if (survey->done) {
+    return 0;
+  }
+  size = ((unsigned long)survey->last - survey->next + 1) / (survey->workers * 4);
+  if (size < 1) {
+    size = 1;
+  } else if (size > MAX_CHUNK) {
+    size = MAX_CHUNK;
+  }
+  chunk[0] = survey->next;
+  chunk[1] = survey->next + (size - 1);
+  if (chunk[1] == survey->last) {
+    survey->done = 1;
+  } else {
+    survey->next = chunk[1] + 1;
+  }
+  return 1;
+}
+
+/* Takes chunks of seeds until there are none left. Every deal gets its own
+ * GameState in the worker's arena, so workers only need to synchronize when
+ * taking a chunk and when reporting a result. Playout statistics are
+ * collected per chunk and reported when the next chunk is taken. */
+static void *run_worker(void *arg) {
+  Survey *survey = arg;
+  Arena *arena = new_arena(DEAL_ARENA_SIZE);
+  MoveList *list = new_move_list();
+  PlayoutStats playout_stats;
+  uint32_t chunk[2];
+  memset(&playout_stats, 0, sizeof(PlayoutStats));
+  while (1) {
+    uint32_t seed;
+    int ok;
+#ifdef USE_PTHREADS
+    pthread_mutex_lock(&survey->lock);
+#endif
+    add_playout_stats(&survey->playout_stats, &playout_stats);
+    ok = next_chunk(survey, chunk);
+#ifdef USE_PTHREADS
+    pthread_mutex_unlock(&survey->lock);
+#endif
+    if (!ok) {
+      break;
+    }
+    for (seed = chunk[0]; ; seed++) {
+      if (survey->playouts) {
+        playout_deal(arena, list, survey->game, seed, &playout_stats);
+      } else {
+        SurveyResult result = survey_deal(arena, survey->game, seed, survey->max_nodes, survey->max_memory);
+#ifdef USE_PTHREADS
+        pthread_mutex_lock(&survey->lock);
+#endif
+        report(survey->out, &result, &survey->stats);
+#ifdef USE_PTHREADS
+        pthread_mutex_unlock(&survey->lock);
+#endif
+      }
+      if (seed == chunk[1]) {
+        break;
+      }
+    }
+  }
+  delete_move_list(list);
+  delete_arena(arena);
+  return NULL;
+}
+
+/* Runs the workers, in parallel if possible */
+static void run_workers(Survey *survey) {
+  int threaded = 0;
+#ifdef USE_PTHREADS
+  if (survey->workers > 1) {
+    pthread_t *threads = malloc(survey->workers * sizeof(pthread_t));
+    int i;
+    pthread_mutex_init(&survey->lock, NULL);
+    for (i = 0; i < survey->workers; i++) {
+      if (pthread_create(&threads[i], NULL, run_worker, survey) != 0) {
+        break;
+      }
+    }
+    threaded = i > 0;
+    while (i > 0) {
+      pthread_join(threads[--i], NULL);
+    }
+    pthread_mutex_destroy(&survey->lock);
+    free(threads);
+  }
+#endif
+  if (!threaded) {
+    run_worker(survey);
+  }
+}
+
+int survey_main(Game *game, unsigned int first_seed, unsigned int last_seed, int workers,
+    long max_nodes, unsigned long max_memory, FILE *out) {
+  Survey survey;
+  SurveyStats *stats = &survey.stats;
+  unsigned long start = get_milliseconds();
+  if (last_seed < first_seed) {
+    fprintf(stderr, "survey: invalid seed range\n");
+    return 0;
+  }
+  memset(&survey, 0, sizeof(survey));
+  survey.game = game;
+  survey.max_nodes = max_nodes;
+  survey.max_memory = max_memory;
+  survey.out = out;
+  survey.next = first_seed;
+  survey.last = last_seed;
+  survey.workers = workers;
+  fprintf(out, "# %s seeds %u-%u\n", game->name, first_seed, last_seed);
+  run_workers(&survey);
+  if (stats->deals) {
+    fprintf(out, "# deals: %ld, solved: %ld (%.1f%%), unsolved: %ld, node-limit: %ld, memory: %ld, time: %ld\n",
+        stats->deals, stats->results[SOLVE_WON], stats->results[SOLVE_WON] * 100.0 / stats->deals,
+        stats->results[SOLVE_LOST], stats->results[SOLVE_NODE_LIMIT], stats->results[SOLVE_MEMORY_LIMIT],
+        stats->results[SOLVE_TIME_LIMIT]);
+    fprintf(out, "# average nodes: %.0f, average time: %.1f ms, wall time: %.1f s\n",
+        stats->nodes / stats->deals, stats->ms / stats->deals, (get_milliseconds() - start) / 1000.0);
+  }
+  return 1;
+}
+
+int playout_main(Game *game, unsigned int first_seed, unsigned int last_seed, int workers, FILE *out) {
+  Survey survey;
+  PlayoutStats *stats = &survey.playout_stats;
+  unsigned long start = get_milliseconds();
+  double seconds;
+  if (last_seed < first_seed) {
+    fprintf(stderr, "playouts: invalid seed range\n");
+    return 0;
+  }
+  memset(&survey, 0, sizeof(survey));
+  survey.game = game;
+  survey.out = out;
+  survey.next = first_seed;
+  survey.last = last_seed;
+  survey.workers = workers;
+  survey.playouts = 1;
+  run_workers(&survey);
+  seconds = (get_milliseconds() - start) / 1000.0;
+  if (seconds <= 0) {
+    seconds = 1e-6;
+  }
+  fprintf(out, "%s: %ld playouts, %ld won (%.1f%%), average length %.1f moves, %ld capped, "
+      "%.0f playouts/s, %.0f moves/s", game->name, stats->playouts, stats->wins,
+      stats->wins * 100.0 / stats->playouts, stats->moves / stats->playouts, stats->capped,
+      stats->playouts / seconds, stats->moves / seconds);
+  if (stats->invalid) {
+    fprintf(out, ", %ld invalid moves", stats->invalid);
+  }
+  fprintf(out, "\n");
+  fflush(out);
+  return !stats->invalid;
+}
+
+int count_processors() {
+#if defined(USE_PTHREADS) && defined(_SC_NPROCESSORS_ONLN)
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  if (n > 0) {
+    return (int)n;
+  }
+#endif
+  return 1;
+}
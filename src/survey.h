@@ -0,0 +1,27 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#ifndef SURVEY_H
+#define SURVEY_H
+
+#include "game.h"
+
+#include <stdio.h>
+
+/* Runs the solver on every seed from `first_seed` to `last_seed` using
+ * `workers` parallel workers, and writes one line per seed to `out`. */
+int survey_main(Game *game, unsigned int first_seed, unsigned int last_seed, int workers,
+    long max_nodes, unsigned long max_memory, FILE *out);
+
+/* Plays every seed from `first_seed` to `last_seed` with uniformly random
+ * legal moves using `workers` parallel workers, and writes the win rate,
+ * average game length and throughput to `out`. Returns 0 if a generated move
+ * was rejected. */
+int playout_main(Game *game, unsigned int first_seed, unsigned int last_seed, int workers, FILE *out);
+
+int count_processors();
+
+#endif
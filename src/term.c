@@ -0,0 +1,84 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#define _XOPEN_SOURCE 500
+
+#include "term.h"
+
+#include "color.h"
+
+#ifdef USE_PDCURSES
+#include <curses.h>
+#else
+#include <ncurses.h>
+#endif
+
+/* Number of cells converted at a time by term_put */
+#define TERM_BUFFER_SIZE 64
+
+static Screen term;
+static int initialized = 0;
+
+static attr_t get_attributes(Cell cell) {
+  attr_t attributes = 0;
+  if (cell.attr & SCREEN_REVERSE) {
+    attributes |= A_REVERSE;
+  }
+  if (cell.attr & SCREEN_BOLD) {
+    attributes |= A_BOLD;
+  }
+  return attributes;
+}
+
+static void term_put(Screen *screen, int y, int x, const Cell *cells, int n) {
+#ifdef USE_PDCURSES
+  chtype buffer[TERM_BUFFER_SIZE];
+#else
+  cchar_t buffer[TERM_BUFFER_SIZE];
+  wchar_t ch[2] = {0, 0};
+#endif
+  while (n > 0) {
+    int length = n < TERM_BUFFER_SIZE ? n : TERM_BUFFER_SIZE, i;
+    for (i = 0; i < length; i++) {
+#ifdef USE_PDCURSES
+      buffer[i] = cells[i].ch | get_attributes(cells[i]) | COLOR_PAIR(cells[i].pair);
+#else
+      ch[0] = cells[i].ch;
+      setcchar(&buffer[i], ch, get_attributes(cells[i]), cells[i].pair, NULL);
+#endif
+    }
+#ifdef USE_PDCURSES
+    mvaddchnstr(y, x, buffer, length);
+#else
+    mvadd_wchnstr(y, x, buffer, length);
+#endif
+    cells += length;
+    x += length;
+    n -= length;
+  }
+}
+
+static void term_erase(Screen *screen) {
+  erase();
+}
+
+/* Returns the screen backed by stdscr. Its size is updated on every call. */
+Screen *term_screen() {
+  if (!initialized) {
+#ifdef USE_PDCURSES
+    term.utf8 = 0;
+#else
+    term.utf8 = 1;
+#endif
+    term.pair = COLOR_PAIR_BACKGROUND;
+    term.attr = 0;
+    term.put = term_put;
+    term.erase = term_erase;
+    initialized = 1;
+  }
+  getmaxyx(stdscr, term.height, term.width);
+  return &term;
+}
@@ -0,0 +1,14 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+#ifndef TERM_H
+#define TERM_H
+
+#include "screen.h"
+
+Screen *term_screen();
+
+#endif
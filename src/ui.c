@@ -4,6 +4,8 @@
  * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
  */
 
+#define _XOPEN_SOURCE 500
+
 #include "ui.h"
 
 #include "rc.h"
@@ -13,7 +15,15 @@
 #include "menu.h"
 #include "color.h"
 #include "config.h"
+#include "error.h"
+#include "save.h"
+#include "solver.h"
+#include "render.h"
+#include "term.h"
+#include "grid.h"
+#include "util.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #ifdef USE_PDCURSES
 #include <curses.h>
@@ -25,11 +35,16 @@
 #include <ctype.h>
 #include <string.h>
 #include <time.h>
+#include <signal.h>
 
-#ifdef PDCURSES
-#define RAW_OUTPUT(n) raw_output(n)
-#else
-#define RAW_OUTPUT(n)
+#if defined(__unix__) || defined(__UNIX__) || defined(__linux__) || defined(__LINUX__)
+#define USE_SIGACTION
+#endif
+
+/* Maximum length of an error message including the terminating null byte */
+#define ERROR_BUFFER_SIZE 1024
+
+#ifndef PDCURSES
 #define KEY_SUP    337
 #define KEY_SDOWN  336
 #endif
@@ -49,12 +64,21 @@ int win_h = 0;
 
 int off_y = 0;
 
+/* Set when the process is asked to terminate */
+static volatile sig_atomic_t terminated = 0;
+
 Card *selection = NULL;
 Pile *selection_pile = NULL;
+/* The selection as of the last frame drawn by ui_loop */
+Card *drawn_selection = NULL;
 Card *cursor_card = NULL;
 Pile *cursor_pile = NULL;
 
-/* Next card in all four directions for smart cursor movement */
+/* Cards and piles on the board by position */
+static Grid *grid = NULL;
+
+/* Next card in all four directions for smart cursor movement, see
+ * find_neighbours */
 Card *n_card = NULL;
 Card *e_card = NULL;
 Card *s_card = NULL;
@@ -79,6 +103,7 @@ enum {
   ACTION_AUTO,
   ACTION_STOCK,
   ACTION_WASTE,
+  ACTION_HINT,
   ACTION_SMART_CURSOR,
   ACTION_VERTICAL_STABILIZATION,
   ACTION_CHANGE_CURSOR,
@@ -101,6 +126,7 @@ Menu move_menu[] = {
   {"&Auto", "a", ACTION_AUTO, NULL, NULL},
   {"From &Stock", "s", ACTION_STOCK, NULL, NULL},
   {"From &Waste", "w", ACTION_WASTE, NULL, NULL},
+  {"Hin&t", "t", ACTION_HINT, NULL, NULL},
   {NULL, NULL, 0, NULL, NULL}
 };
 
@@ -134,277 +160,107 @@ Menu *menu_selection[] = {
   NULL
 };
 
-static void print_card_name_l(int y, int x, Card *card, Theme *theme) {
-  if (y < 0 || y >= win_h) {
-    return;
-  }
-  RAW_OUTPUT(1);
-  mvprintw(y, x, "%s", theme->ranks[card->rank - 1]);
-  printw("%s", card_suit(card, theme));
-  RAW_OUTPUT(0);
-}
-
-static int utf8strlen(char *s) {
-#if USE_PDCURSES
-  return strlen(s);
-#else
-  int length = 0;
-  while (*s) {
-    length += ((*s >> 6) & 3) != 2;
-    s++;
-  }
-  return length;
-#endif
-}
-
-static void print_card_name_r(int y, int x, Card *card, Theme *theme) {
-  char *suit_symbol, *rank_symbol;
-  int width;
-  if (y < 0 || y >= win_h) {
-    return;
-  }
-  suit_symbol = card_suit(card, theme);
-  rank_symbol = theme->ranks[card->rank - 1];
-  width = utf8strlen(suit_symbol) + utf8strlen(rank_symbol);
-  RAW_OUTPUT(1);
-  mvprintw(y, x - width, "%s%s", suit_symbol, rank_symbol);
-  RAW_OUTPUT(0);
-}
-
-static void print_text(int y, int x, Card *card, Text text, int fill, Theme *theme) {
-  char *suit_symbol = "", *rank_symbol = "";
-  if ((!fill && text.y != 0) || !text.format) {
-    return;
-  }
-  if (text.y < 0) {
-    y += theme->height + text.y;
-  }
-  if (text.x < 0) {
-    x += theme->width + text.x;
-  }
-  if (y < 0 || y >= win_h) {
-    return;
-  }
-  if (text.format == TEXT_RANK_SUIT || text.format == TEXT_SUIT_RANK
-      || text.format == TEXT_SUIT) {
-    suit_symbol = card_suit(card, theme);
-  }
-  if (text.format == TEXT_RANK_SUIT || text.format == TEXT_SUIT_RANK
-      || text.format == TEXT_RANK) {
-    rank_symbol = theme->ranks[card->rank - 1];
-  }
-  if (text.align_right) {
-    x -= utf8strlen(suit_symbol) + utf8strlen(rank_symbol) - 1;
-  }
-  RAW_OUTPUT(1);
-  if (text.format == TEXT_RANK_SUIT) {
-    mvprintw(y, x, "%s%s", rank_symbol, suit_symbol);
-  } else {
-    mvprintw(y, x, "%s%s", suit_symbol, rank_symbol);
-  }
-  RAW_OUTPUT(0);
-}
-
-static void print_layout(int y, int x, Card *card, Layout layout, int full, Theme *theme) {
-  Text *field;
-  if (y >= win_h) {
-    return;
-  }
-  if (y >= 0) {
-    mvprintw(y, x, layout.top);
-  }
-  if (full && theme->height > 1) {
-    int i;
-    for (i = 1; i < theme->height - 1; i++) {
-      if (y + i >= 0 && y + i < win_h) {
-        mvprintw(y + i, x, layout.middle);
-      }
-    }
-    if (y + theme->height > 0 && y + theme->height <= win_h) {
-      mvprintw(y + theme->height - 1, x, layout.bottom);
-    }
-  }
-  for (field = layout.text_fields; field; field = field->next) {
-    print_text(y, x, card, *field, full, theme);
-  }
-}
-
-static void print_card(int y, int x, Card *card, int full, Theme *theme) {
-  if (card == selection) {
-    attron(A_REVERSE);
-  }
-  if (card->suit & BOTTOM) {
-    attron(COLOR_PAIR(COLOR_PAIR_EMPTY));
-    print_layout(y, x, card, theme->empty_layout, full, theme);
-    if (!theme->empty_layout.text_fields && card->rank > 0) {
-      print_card_name_l(y, x + theme->empty_layout.left_padding, card, theme);
-    }
-  } else if (!card->up) {
-    attron(COLOR_PAIR(COLOR_PAIR_BACK));
-    print_layout(y, x, card, theme->back_layout, full, theme);
-  } else {
-    int left_padding, right_padding, has_text;
-    if (card->suit & RED) {
-      attron(COLOR_PAIR(COLOR_PAIR_RED));
-      print_layout(y, x, card, theme->red_layout, full, theme);
-      left_padding = theme->red_layout.left_padding;
-      right_padding = theme->red_layout.right_padding;
-      has_text = !!theme->red_layout.text_fields;
-    } else {
-      attron(COLOR_PAIR(COLOR_PAIR_BLACK));
-      print_layout(y, x, card, theme->black_layout, full, theme);
-      left_padding = theme->black_layout.left_padding;
-      right_padding = theme->black_layout.right_padding;
-      has_text = !!theme->black_layout.text_fields;
-    }
-    if (!has_text) {
-      if (full && theme->height > 1) {
-        print_card_name_r(y + theme->height - 1, x + theme->width - right_padding, card, theme);
+/* Looks up the card and pile under the cursor, and the cards and piles next
+ * to it for smart cursor movement */
+static void find_neighbours(Pile *piles, Theme *theme) {
+  GridCell *cell = get_grid_cell(grid, cur_x, cur_y);
+  int row_y = keep_vertical_position ? cur_y : max_cur_y;
+  GridCell *row = get_grid_cell(grid, cur_x, row_y);
+  Card *leftmost = get_leftmost(grid, row_y);
+  Card *rightmost = get_rightmost(grid, row_y);
+  Pile *pile;
+  cursor_card = cell->card;
+  cursor_pile = cell->pile;
+  n_card = cell->north;
+  s_card = cell->south;
+  w_card = row->west;
+  e_card = row->east;
+  wm_card = leftmost && leftmost->x < cur_x ? leftmost : NULL;
+  em_card = rightmost && rightmost->x > cur_x ? rightmost : NULL;
+  max_x = grid->max_x;
+  max_y = grid->max_y;
+  n_pile = e_pile = s_pile = w_pile = NULL;
+  em_pile = wm_pile = NULL;
+  for (pile = piles; pile; pile = pile->next) {
+    int y = pile->rule->y * (theme->height + theme->y_spacing);
+    if (pile->rule->type == RULE_STOCK || pile->stack->suit != TABLEAU) {
+      if (pile->rule->x != cur_x || get_top(pile->stack) == cursor_card) {
+        continue;
       }
-      print_card_name_l(y, x + left_padding, card, theme);
-    }
-  }
-  if (card == selection) {
-    attroff(A_REVERSE);
-  }
-}
-
-static int theme_y(int y, Theme *theme) {
-  return theme->y_margin + off_y + y;
-}
-
-static int theme_x(int x, Theme *theme) {
-  return theme->x_margin + x * (theme->width + theme->x_spacing);
-}
-
-static void update_directions(Card *card, int y_max) {
-  if (!card->up && card->next) {
-    return;
-  }
-  if (card->x == cur_x) {
-    if (card->y < cur_y && (card->next || y_max < cur_y)) {
-      if (!n_card || card->y > n_card->y) {
-        n_card = card;
+      if (y < cur_y && (!n_pile || n_pile->rule->y < pile->rule->y)) {
+        n_pile = pile;
+      } else if (y > cur_y && (!s_pile || s_pile->rule->y > pile->rule->y)) {
+        s_pile = pile;
       }
-    } else if (card->y > cur_y) {
-      if (!s_card || card->y < s_card->y) {
-        s_card = card;
+    } else if (cur_y < y) {
+      if (pile->rule->x == cur_x) {
+        s_pile = pile;
       }
-    }
-  }
-  if (keep_vertical_position
-      ? card->y <= cur_y && y_max >= cur_y
-      : card->y <= max_cur_y && y_max >= max_cur_y) {
-    if (card->x < cur_x) {
-      if (!w_card || card->x > w_card->x) {
-        w_card = card;
+    } else if (pile->rule->x < cur_x) {
+      if (!w_pile || w_pile->rule->x < pile->rule->x) {
+        w_pile = pile;
       }
-      if (!wm_card || card->x < wm_card->x) {
-        wm_card = card;
+      if (!wm_pile || wm_pile->rule->x > pile->rule->x) {
+        wm_pile = pile;
       }
-    } else if (card->x > cur_x) {
-      if (!e_card || card->x < e_card->x) {
-        e_card = card;
+    } else if (pile->rule->x > cur_x) {
+      if (!e_pile || e_pile->rule->x > pile->rule->x) {
+        e_pile = pile;
       }
-      if (!em_card || card->x > em_card->x) {
-        em_card = card;
+      if (!em_pile || em_pile->rule->x < pile->rule->x) {
+        em_pile = pile;
       }
     }
   }
 }
 
-static int print_card_in_grid(int y, int x, Card *card, int full, Theme *theme) {
-  int y2 = y + full * (theme->height - 1);
-  if (y2 > max_y) max_y = y2;
-  if (x > max_x) max_x = x;
-  if (y <= cur_y && y2 >= cur_y && x == cur_x) cursor_card = card;
-  card->x = x;
-  card->y = y;
-  update_directions(card, y2);
-  y = theme_y(y, theme);
-  x = theme_x(x, theme);
-  if (win_h - 1 < y) {
-    return 0;
+/* Lays out the piles without drawing them and rebuilds the grid if any of
+ * them moved. Used while input is handled ahead of the next frame. */
+static void layout_board(GameState *state, Theme *theme, int all) {
+  if (all || memchr(state->damage, 1, state->pile_count)) {
+    layout_piles(state, theme, all);
+    build_grid(grid, state->piles, theme);
   }
-  print_card(y, x, card, full, theme);
-  return cursor_card == card;
-}
-
-static int print_card_top(int y, int x, Card *card, Theme *theme) {
-  return print_card_in_grid(y, x, card, 0, theme);
-}
-
-static int print_card_full(int y, int x, Card *card, Theme *theme) {
-  return print_card_in_grid(y, x, card, 1, theme);
 }
 
-static int print_stack(int y, int x, Card *bottom, Theme *theme) {
-  if (bottom->next) {
-    return print_stack(y, x, bottom->next, theme);
-  } else {
-    return print_card_full(y, x, bottom, theme);
+/* Draws the piles that have changed since the last frame, see draw_piles,
+ * and rebuilds the grid if any of them moved. Piles where the selection was
+ * added or removed are redrawn too. */
+static void print_piles(GameState *state, Theme *theme, int *bottoms, int all) {
+  int moved = all || memchr(state->damage, 1, state->pile_count);
+  if (!all && selection != drawn_selection) {
+    if (drawn_selection) {
+      state->damage[drawn_selection->stack->id] = 1;
+    }
+    if (selection) {
+      state->damage[selection->stack->id] = 1;
+    }
+  }
+  drawn_selection = selection;
+  draw_piles(term_screen(), state, theme, off_y, selection, bottoms, all);
+  if (moved) {
+    build_grid(grid, state->piles, theme);
   }
 }
 
-static int print_tableau(int y, int x, Card *bottom, Theme *theme) {
-  if (bottom->next && bottom->suit & BOTTOM) {
-    return print_tableau(y, x, bottom->next, theme);
-  } else {
-    if (bottom->next) {
-      int cursor_below = print_card_top(y, x, bottom, theme);
-      return print_tableau(y + 1, x, bottom->next, theme) || cursor_below;
-    } else {
-      int cursor_below = cur_x == x && cur_y >= y;
-      return print_card_full(y, x, bottom, theme) || cursor_below;
-    }
+/* The time left until the next frame may be drawn, see frame_rate */
+static int get_frame_delay(unsigned long last_frame) {
+  unsigned long elapsed;
+  if (frame_rate <= 0) {
+    return 0;
   }
+  elapsed = get_milliseconds() - last_frame;
+  return elapsed < 1000 / frame_rate ? 1000 / frame_rate - elapsed : 0;
 }
 
-static void print_pile(Pile *pile, Theme *theme) {
-  int y = pile->rule->y * (theme->height + theme->y_spacing);
-  if (pile->rule->type == RULE_STOCK) {
-    Card *top = get_top(pile->stack);
-    top->up = 0;
-    if (print_card_full(y, pile->rule->x, top, theme)) {
-      cursor_pile = pile;
-    } else if (pile->rule->x == cur_x) {
-      if (y < cur_y && (!n_pile || n_pile->rule->y < pile->rule->y)) {
-        n_pile = pile;
-      } else if (y > cur_y && (!s_pile || s_pile->rule->y > pile->rule->y)) {
-        s_pile = pile;
-      }
-    }
-  } else if (pile->stack->suit == TABLEAU) {
-    if (print_tableau(y, pile->rule->x, pile->stack, theme)) {
-      cursor_pile = pile;
-    } else if (cur_y >= y) {
-      if (pile->rule->x < cur_x) {
-        if (!w_pile || w_pile->rule->x < pile->rule->x) {
-          w_pile = pile;
-        }
-        if (!wm_pile || wm_pile->rule->x > pile->rule->x) {
-          wm_pile = pile;
-        }
-      } else if (pile->rule->x > cur_x) {
-        if (!e_pile || e_pile->rule->x > pile->rule->x) {
-          e_pile = pile;
-        }
-        if (!em_pile || em_pile->rule->x < pile->rule->x) {
-          em_pile = pile;
-        }
-      }
-    } else if (pile->rule->x == cur_x) {
-      s_pile = pile;
-    }
-  } else if (print_stack(y, pile->rule->x, pile->stack, theme)) {
-    cursor_pile = pile;
-  } else if (pile->rule->x == cur_x) {
-    if (y < cur_y && (!n_pile || n_pile->rule->y < pile->rule->y)) {
-      n_pile = pile;
-    } else if (y > cur_y && (!s_pile || s_pile->rule->y > pile->rule->y)) {
-      s_pile = pile;
-    }
-  }
+/* Returns the next key if one arrives within `delay` milliseconds, otherwise
+ * ERR */
+static int poll_key(int delay) {
+  int ch;
+  timeout(delay);
+  ch = getch();
+  timeout(-1);
+  return ch;
 }
 
 void format_time(char *out, int32_t time) {
@@ -422,71 +278,84 @@ void format_time(char *out, int32_t time) {
   }
 }
 
+/* Draws a centered box with a line of text on each row */
+static void ui_dialog(Screen *screen, int width, const char **lines) {
+  int height = 2, y, x;
+  while (lines[height - 2]) {
+    height++;
+  }
+  y = screen->height / 2 - 3;
+  x = screen->width >= width ? screen->width / 2 - width / 2 : 0;
+  screen->pair = COLOR_PAIR_BACKGROUND;
+  screen->attr = 0;
+  ui_box(screen, y, x, height, width, 1);
+  while (*lines) {
+    screen_print(screen, ++y, x + 2, *lines++);
+  }
+}
+
 static void how_to_play() {
-  int y, x;
-  int height = 7;
-  int width = 60;
-  getmaxyx(stdscr, win_h, win_w);
-  y = win_h / 2 - 3;
-  x = win_w >= width ? win_w / 2 - width / 2 : 0;
-  attron(COLOR_PAIR(COLOR_PAIR_BACKGROUND));
-  ui_box(y, x, height, width, 1);
-  mvprintw(y + 1, x + 2, "Use the arrow keys or h, j, k, and l to move the cursor.");
-  mvprintw(y + 2, x + 2, "Press space to select the card under the cursor.");
-  mvprintw(y + 3, x + 2, "With a card selected, move the cursor again and press");
-  mvprintw(y + 4, x + 2, "Enter or m to move the selected card to the position");
-  mvprintw(y + 5, x + 2, "under the cursor.");
+  const char *lines[] = {
+    "Use the arrow keys or h, j, k, and l to move the cursor.",
+    "Press space to select the card under the cursor.",
+    "With a card selected, move the cursor again and press",
+    "Enter or m to move the selected card to the position",
+    "under the cursor.",
+    NULL
+  };
+  ui_dialog(term_screen(), 60, lines);
   getch();
 }
 
 static void about() {
-  int y, x;
-  int height = 5;
-  int width = 50;
-  getmaxyx(stdscr, win_h, win_w);
-  y = win_h / 2 - 3;
-  x = win_w >= width ? win_w / 2 - width / 2 : 0;
-  attron(COLOR_PAIR(COLOR_PAIR_BACKGROUND));
-  ui_box(y, x, height, width, 1);
-  mvprintw(y + 1, x + 2, "csol " CSOL_VERSION);
-  mvprintw(y + 2, x + 2, "Copyright (c) 2017-2023 Niels Sonnich Poulsen");
-  mvprintw(y + 3, x + 2, "https://nielssp.dk/csol");
+  const char *lines[] = {
+    "csol " CSOL_VERSION,
+    "Copyright (c) 2017-2023 Niels Sonnich Poulsen",
+    "https://nielssp.dk/csol",
+    NULL
+  };
+  ui_dialog(term_screen(), 50, lines);
   getch();
 }
 
-static void ui_victory_banner(int y, int x, int32_t score, int32_t time, Stats stats) {
+static void ui_victory_banner(Screen *screen, int y, int x, int32_t score, int32_t time, Stats stats) {
   char time_buffer[18];
+  char line[64];
   int height = 4;
   if (stats.times_played > 1 && stats.best_time >= 0) {
     height += 1;
   }
-  attron(COLOR_PAIR(COLOR_PAIR_BACKGROUND));
-  ui_box(y, x, height, 38, 1);
+  screen->pair = COLOR_PAIR_BACKGROUND;
+  screen->attr = 0;
+  ui_box(screen, y, x, height, 38, 1);
   format_time(time_buffer, time);
-  mvprintw(y + 1, x + 2, "VICTORY!  Score: %" PRId32 " / %s", score, time_buffer);
+  sprintf(line, "VICTORY!  Score: %" PRId32 " / %s", score, time_buffer);
+  screen_print(screen, y + 1, x + 2, line);
   if (stats.times_played > 1 && stats.best_time >= 0) {
     format_time(time_buffer, stats.best_time);
-    mvprintw(y + 2, x + 12, "Best:  %" PRId32 " / %s", stats.best_score,
-        time_buffer);
+    sprintf(line, "Best:  %" PRId32 " / %s", stats.best_score, time_buffer);
+    screen_print(screen, y + 2, x + 12, line);
   }
-  mvprintw(y + height - 2, x + 2, "Press 'r' to redeal or 'q' to quit");
+  screen_print(screen, y + height - 2, x + 2, "Press 'r' to redeal or 'q' to quit");
 }
 
 static int ui_victory(Pile *piles, Theme *theme, int32_t score, int32_t time, Stats stats) {
+  Screen *screen = term_screen();
   int banner_y, banner_x;
   Pile *pile;
   Card *card;
-  getmaxyx(stdscr, win_h, win_w);
+  win_h = screen->height;
+  win_w = screen->width;
   banner_y = win_h / 2 - 3;
   banner_x = win_w >= 38 ? win_w / 2 - 19 : 0;
   nodelay(stdscr, 1);
   curs_set(0);
   for (pile = piles; pile; pile = pile->next) {
     int pile_y = pile->rule->y * (theme->height + theme->y_spacing);
-    for (card = get_top(pile->stack); NOT_BOTTOM(card); card = card->prev) {
+    for (card = get_top(pile->stack); NOT_BOTTOM(card); card = prev_card(card)) {
       double y, x, vy, vx;
       card->up = 1;
-      y = (double)theme_y(pile_y, theme);
+      y = (double)theme_y(pile_y, theme, off_y);
       x = (double)theme_x(pile->rule->x, theme);
       vy = (double)rand() / RAND_MAX * -4.0;
       vx = (double)rand() / RAND_MAX * 8.0 - 4.0;
@@ -499,8 +368,8 @@ static int ui_victory(Pile *piles, Theme *theme, int32_t score, int32_t time, St
           case 'q':
             return 0;
         }
-        print_card(y, x, card, 1, theme);
-        ui_victory_banner(banner_y, banner_x, score, time, stats);
+        draw_card(screen, y, x, card, 1, 0);
+        ui_victory_banner(screen, banner_y, banner_x, score, time, stats);
         refresh();
         napms(70);
         y += vy;
@@ -528,57 +397,236 @@ static int ui_victory(Pile *piles, Theme *theme, int32_t score, int32_t time, St
   }
 }
 
-static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
+/* Shows an error on an otherwise empty screen. Lines that are too long for
+ * the screen are wrapped. */
+static void show_error(const char *format, va_list va) {
+  Screen *screen = term_screen();
+  char message[ERROR_BUFFER_SIZE];
+  char *line = message;
+  int y = 0;
+  vsnprintf(message, sizeof(message), format, va);
+  screen->pair = COLOR_PAIR_BACKGROUND;
+  screen->attr = 0;
+  screen_erase(screen);
+  while (*line) {
+    int length = strcspn(line, "\n");
+    char end;
+    if (length > screen->width) {
+      length = screen->width;
+      /* Don't split UTF-8 sequences */
+      while (length > 1 && (line[length] & 0xC0) == 0x80) {
+        length--;
+      }
+    }
+    end = line[length];
+    line[length] = '\0';
+    screen_print(screen, y++, 0, line);
+    line[length] = end;
+    line += length + (end == '\n');
+  }
+  screen_print(screen, y, 0, "Press any key to continue");
+  refresh();
+  getch();
+  clear();
+}
+
+static void handle_terminate(int signal) {
+  terminated = 1;
+}
+
+/* Reading from the terminal must be interrupted by the signal, so the
+ * handler is installed without SA_RESTART. */
+static void catch_terminate() {
+#ifdef USE_SIGACTION
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = handle_terminate;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGTERM, &action, NULL);
+  sigaction(SIGHUP, &action, NULL);
+#else
+  signal(SIGTERM, handle_terminate);
+#endif
+}
+
+/* Saves an unfinished game if autosave is enabled, otherwise records it as
+ * lost. */
+static void quit_game(Game *game, GameState *state, unsigned int seed, int32_t duration) {
+  if (!save_game(game->name, seed, duration, state)) {
+    append_score(game->name, 0, state->score, duration, NULL);
+    archive_replay(game, seed, state);
+  }
+}
+
+/* Plays the moves of a replay, showing the board for `delay` milliseconds
+ * before each move. Space pauses the replay, the cursor keys seek 10 moves
+ * backward or forward (100 with shift). The replay is paused after the last
+ * move, and any other key leaves it and continues from the final position. */
+static void ui_replay(Game *game, Theme *theme, GameState *state, Replay *replay, int delay) {
+  Arena *arena = new_arena(DEAL_ARENA_SIZE);
+  GameState *view = NULL;
+  int position = 0, shown = 0, paused = 0, i;
+  char status[32];
+  while (delay > 0 && !terminated) {
+    Screen *screen;
+    int score_width = 0;
+    view = seek_replay(arena, game, replay, view, shown, position);
+    if (!view) {
+      break;
+    }
+    shown = position;
+    getmaxyx(stdscr, win_h, win_w);
+    screen = term_screen();
+    draw_piles(screen, view, theme, off_y, NULL, NULL, 1);
+    if (show_score) {
+      draw_score(screen, view->score, &score_width);
+    }
+    sprintf(status, "Move %d/%d", position, replay->size);
+    screen_print(screen, win_h - 1, win_w - strlen(status), status);
+    refresh();
+    timeout(paused ? -1 : delay);
+    switch (getch()) {
+      case ERR:
+        position++;
+        break;
+      case ' ':
+        paused = !paused;
+        break;
+      case KEY_RESIZE:
+        break;
+      case 'h':
+      case KEY_LEFT:
+        position -= 10;
+        break;
+      case 'l':
+      case KEY_RIGHT:
+        position += 10;
+        break;
+      case 'H':
+      case KEY_SLEFT:
+        position -= 100;
+        break;
+      case 'L':
+      case KEY_SRIGHT:
+        position += 100;
+        break;
+      default:
+        delay = 0;
+        break;
+    }
+    timeout(-1);
+    if (position < 0) {
+      position = 0;
+    } else if (position >= replay->size) {
+      position = replay->size;
+      paused = 1;
+    }
+  }
+  delete_arena(arena);
+  for (i = 0; i < replay->size; i++) {
+    if (!replay_record(state, replay->records[i])) {
+      print_error("Replay stopped: move %d is invalid", i + 1);
+      break;
+    }
+  }
+}
+
+/* Shows a hinted move by selecting the cards to move and placing the cursor
+ * on the destination, so that the move can be made with Enter. For other
+ * moves the cursor is placed on the pile that Space should be pressed on.
+ * The selection is limited to the face-up cards that are shown. */
+static void show_hint(Pile *piles, Move hint) {
+  Pile *src = get_pile(piles, hint.src);
+  Card *target;
+  if (hint.type == MOVE_STACK) {
+    Stack *stack = src->stack->stack;
+    Card *first = get_first_shown(src);
+    selection = stack->cards[stack->size - hint.count];
+    if (selection->index < first->index) {
+      selection = first;
+    }
+    while (!selection->up && next_card(selection)) {
+      selection = next_card(selection);
+    }
+    selection_pile = src;
+    target = get_top(get_pile(piles, hint.dest)->stack);
+  } else {
+    selection = NULL;
+    selection_pile = NULL;
+    target = get_top(src->stack);
+  }
+  cur_x = target->x;
+  cur_y = max_cur_y = target->y;
+}
+
+/* Plays a game until it is won, abandoned or quit. A non-negative `duration`
+ * is the time already spent on a resumed game. */
+static int ui_loop(Game **current_game, Theme **current_theme, GameState *state, unsigned int seed,
+    int32_t duration) {
   MEVENT mouse;
   MenuClick menu_click = {0, 0, 0};
   int new_game = 1;
   int move_made = 0;
   int mouse_action = 0;
-  int game_started = 0;
-  time_t start_time;
+  int game_started = duration >= 0;
+  time_t start_time = time(NULL) - duration;
   int old_cur_x = 0;
   int old_cur_y = 0;
+  int redraw = 1;
+  int score_width = 0;
+  int key = ERR;
+  unsigned long last_frame = 0;
+  int menu_action;
   void *menu_data = NULL;
   Game *game = *current_game;
   Theme *theme = *current_theme;
+  Pile *piles = state->piles;
+  int *bottoms = arena_alloc(state->arena, state->pile_count * sizeof(int));
   selection = NULL;
   selection_pile = NULL;
+  drawn_selection = NULL;
   clear();
-  clear_undo_history();
-  move_counter = 0;
-  game_score = 0;
   off_y = 0;
   wbkgd(stdscr, COLOR_PAIR(COLOR_PAIR_BACKGROUND));
   refresh();
   while (1) {
-    Pile *pile;
-    int ch;
-    cursor_card = NULL;
-    n_card = e_card = s_card = w_card = NULL;
-    n_pile = e_pile = s_pile = w_pile = NULL;
-    em_card = wm_card = NULL;
-    em_pile = wm_pile = NULL;
-    cursor_pile = NULL;
-    max_x = max_y = 0;
+    int ch, batched;
+    /* Keys that are already waiting, or that arrive before the next frame may
+     * be drawn, are handled before the board is drawn again */
+    if (key == ERR && !mouse_action && !menu_selection[0] && !terminated) {
+      key = poll_key(get_frame_delay(last_frame));
+    }
+    batched = key != ERR;
     getmaxyx(stdscr, win_h, win_w);
     if (theme->y_margin + off_y + cur_y >= win_h) {
-      clear();
+      redraw = 1;
       off_y = win_h - cur_y - theme->y_margin - 1;
     }
     if (theme->y_margin + off_y + cur_y < 0) {
-      clear();
+      redraw = 1;
       off_y = -theme->y_margin - cur_y;
       if (cur_y == 0) {
         off_y = 0;
       }
     }
-    for (pile = piles; pile; pile = pile->next) {
-      print_pile(pile, theme);
+    if (message_shown && memchr(state->damage, 1, state->pile_count)) {
+      redraw = 1;
     }
-    attron(COLOR_PAIR(COLOR_PAIR_BACKGROUND));
-    if (show_score) {
-      mvprintw(win_h - 1, 0, "Score: %d", game_score);
+    if (redraw) {
+      message_shown = 0;
+    }
+    if (batched) {
+      layout_board(state, theme, redraw);
+    } else {
+      print_piles(state, theme, bottoms, redraw);
+      redraw = 0;
+      last_frame = get_milliseconds();
+      attron(COLOR_PAIR(COLOR_PAIR_BACKGROUND));
+      if (show_score) {
+        draw_score(term_screen(), state->score, &score_width);
+      }
     }
+    find_neighbours(piles, theme);
     if (new_game) {
       new_game = 0;
       if (smart_cursor && !cursor_card) {
@@ -597,9 +645,9 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
       if (!keep_vertical_position) {
         if (cursor_card && cursor_card->y < cur_y) {
           cur_y = cursor_card->y;
-        } else if (cursor_card && cursor_card->next && cur_y < max_cur_y) {
-          while (cursor_card->next && cursor_card->y < max_cur_y) {
-            cursor_card = cursor_card->next;
+        } else if (cursor_card && next_card(cursor_card) && cur_y < max_cur_y) {
+          while (next_card(cursor_card) && cursor_card->y < max_cur_y) {
+            cursor_card = next_card(cursor_card);
           }
           cur_x = cursor_card->x;
           cur_y = cursor_card->y;
@@ -617,21 +665,30 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
         continue;
       }
     }
-    if (alt_cursor) {
-      mvprintw(theme->y_margin + off_y + old_cur_y,
-          theme->x_margin + old_cur_x * (theme->width + theme->x_spacing) - 1, " ");
-      mvprintw(theme->y_margin + off_y + old_cur_y,
-          theme->x_margin + old_cur_x * (theme->width + theme->x_spacing) + theme->width, " ");
+    if (alt_cursor && !batched) {
+      Screen *screen = term_screen();
+      int y = theme_y(old_cur_y, theme, off_y), x = theme_x(old_cur_x, theme);
+      screen->pair = COLOR_PAIR_BACKGROUND;
+      screen->attr = 0;
+      screen_print(screen, y, x - 1, " ");
+      screen_print(screen, y, x + theme->width, " ");
       refresh();
-      mvprintw(theme->y_margin + off_y + cur_y,
-          theme->x_margin + cur_x * (theme->width + theme->x_spacing) - 1, ">");
-      mvprintw(theme->y_margin + off_y + cur_y,
-          theme->x_margin + cur_x * (theme->width + theme->x_spacing) + theme->width, "<");
+      y = theme_y(cur_y, theme, off_y);
+      x = theme_x(cur_x, theme);
+      screen_print(screen, y, x - 1, ">");
+      screen_print(screen, y, x + theme->width, "<");
       old_cur_x = cur_x;
       old_cur_y = cur_y;
     }
 
-    switch (ui_menubar(main_menu, menu_selection, &menu_data, &menu_click)) {
+    menu_action = MENU_IS_CLOSED;
+    if (!batched) {
+      menu_action = ui_menubar(main_menu, menu_selection, &menu_data, &menu_click);
+    }
+    if (menu_action != MENU_IS_CLOSED) {
+      redraw = 1;
+    }
+    switch (menu_action) {
       case MENU_IS_CLOSED:
         break;
       case ACTION_RESTART:
@@ -658,25 +715,30 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
       case ACTION_WASTE:
         mouse_action = 'w';
         continue;
+      case ACTION_HINT:
+        mouse_action = 't';
+        continue;
       case ACTION_GAME:
         if (!game_started || ui_confirm("Redeal?")) {
           if (game_started) {
-            append_score(game->name, 0, game_score, time(NULL) - start_time, NULL);
+            append_score(game->name, 0, state->score, time(NULL) - start_time, NULL);
+            archive_replay(game, seed, state);
           }
           *current_game = menu_data;
           return 1;
         }
-        clear();
+        redraw = 1;
         continue;
       case ACTION_THEME:
         restore_colors(theme);
         *current_theme = theme = menu_data;
         convert_theme(theme);
         init_theme_colors(theme);
+        cache_glyphs(theme);
         if (show_menu && theme->y_margin < 2) {
           theme->y_margin = 2;
         }
-        clear();
+        redraw = 1;
         continue;
       case ACTION_SMART_CURSOR:
         smart_cursor = !smart_cursor;
@@ -687,15 +749,15 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
       case ACTION_CHANGE_CURSOR:
         alt_cursor = !alt_cursor;
         curs_set(!alt_cursor);
-        clear();
+        redraw = 1;
         continue;
       case ACTION_SHOW_SCORE:
         show_score = !show_score;
-        clear();
+        redraw = 1;
         continue;
       case ACTION_SHOW_MENUBAR:
         show_menu = !show_menu;
-        clear();
+        redraw = 1;
         continue;
       case ACTION_HOW_TO_PLAY:
         mouse_action = '?';
@@ -720,8 +782,14 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
       if (check_win_condition(piles)) {
         Stats stats;
         int32_t duration = difftime(time(NULL), start_time);
-        append_score(game->name, 1, game_score, duration, &stats);
-        return ui_victory(piles, theme, game_score, duration, stats);
+        append_score(game->name, 1, state->score, duration, &stats);
+        archive_replay(game, seed, state);
+        if (batched) {
+          /* The waiting key is left for the victory screen */
+          ungetch(key);
+          print_piles(state, theme, bottoms, redraw);
+        }
+        return ui_victory(piles, theme, state->score, duration, stats);
       }
       move_made = 0;
     }
@@ -729,9 +797,18 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
     if (mouse_action) {
       ch = mouse_action;
       mouse_action = 0;
-    } else {
+    } else if (key != ERR) {
+      ch = key;
+      key = ERR;
+    } else if (!terminated) {
       ch = getch();
     }
+    if (terminated) {
+      if (game_started) {
+        quit_game(game, state, seed, time(NULL) - start_time);
+      }
+      return 0;
+    }
     switch (ch) {
       case 'h':
       case KEY_LEFT:
@@ -741,8 +818,8 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
               cur_x = w_pile->rule->x;
             } else {
               Card *card = w_pile->stack;
-              while (card->next && (IS_BOTTOM(card) || !card->up || card->y < max_cur_y)) {
-                card = card->next;
+              while (next_card(card) && (IS_BOTTOM(card) || !card->up || card->y < max_cur_y)) {
+                card = next_card(card);
               }
               cur_x = card->x;
               cur_y = card->y;
@@ -780,7 +857,7 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
             max_cur_y = cur_y;
           } else if (off_y < 0) {
             off_y++;
-            clear();
+            redraw = 1;
           }
         } else {
           cur_y--;
@@ -795,8 +872,8 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
               cur_x = e_pile->rule->x;
             } else {
               Card *card = e_pile->stack;
-              while (card->next && (IS_BOTTOM(card) || !card->up || card->y < max_cur_y)) {
-                card = card->next;
+              while (next_card(card) && (IS_BOTTOM(card) || !card->up || card->y < max_cur_y)) {
+                card = next_card(card);
               }
               cur_x = card->x;
               cur_y = card->y;
@@ -815,10 +892,11 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
       case 'K':
       case KEY_SUP:
         if (cursor_card) {
-          if (cursor_card->prev && NOT_BOTTOM(cursor_card->prev) && cursor_card->prev->up) {
-            Card *card = cursor_card->prev;
-            while (card->prev && card->prev->up == card->up && NOT_BOTTOM(card->prev)) {
-              card = card->prev;
+          Card *prev = prev_card(cursor_card);
+          if (prev && NOT_BOTTOM(prev) && prev->up) {
+            Card *card = prev;
+            while ((prev = prev_card(card)) && prev->up == card->up && NOT_BOTTOM(prev)) {
+              card = prev;
             }
             cur_y = card->y;
           } else if (n_pile) {
@@ -845,21 +923,21 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
         break;
       case 'J':
       case KEY_SDOWN:
-        if (cursor_card && cursor_card->next) {
+        if (cursor_card && next_card(cursor_card)) {
           Card *card;
           if (cursor_card->up) {
             card = get_top(cursor_card);
           } else {
-            card = cursor_card->next;
-            while (!card->up && card->next) {
-              card = card->next;
+            card = next_card(cursor_card);
+            while (!card->up && next_card(card)) {
+              card = next_card(card);
             }
           }
           cur_y = card->y;
         } else if (s_pile) {
           Card *card = s_pile->stack;
-          while ((IS_BOTTOM(card) || !card->up) && card->next) {
-            card = card->next;
+          while ((IS_BOTTOM(card) || !card->up) && next_card(card)) {
+            card = next_card(card);
           }
           cur_y = card->y;
         } else if (s_card) {
@@ -879,8 +957,8 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
               cur_x = wm_pile->rule->x;
             } else {
               Card *card = wm_pile->stack;
-              while (card->next && (IS_BOTTOM(card) || !card->up || card->y < cur_y)) {
-                card = card->next;
+              while (next_card(card) && (IS_BOTTOM(card) || !card->up || card->y < cur_y)) {
+                card = next_card(card);
               }
               cur_x = card->x;
               cur_y = card->y;
@@ -903,8 +981,8 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
               cur_x = em_pile->rule->x;
             } else {
               Card *card = em_pile->stack;
-              while (card->next && (IS_BOTTOM(card) || !card->up || card->y < cur_y)) {
-                card = card->next;
+              while (next_card(card) && (IS_BOTTOM(card) || !card->up || card->y < cur_y)) {
+                card = next_card(card);
               }
               cur_x = card->x;
               cur_y = card->y;
@@ -924,34 +1002,31 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
           if (!(cursor_card->suit & BOTTOM)) {
             if (cursor_card->up) {
               if (selection == cursor_card) {
-                if (move_to_foundation(cursor_card, cursor_pile, piles) || move_to_free_cell(cursor_card, cursor_pile, piles)) {
+                if (move_to_foundation(state, cursor_card, cursor_pile) || move_to_free_cell(state, cursor_card, cursor_pile)) {
                   move_made = 1;
-                  clear();
                   selection = NULL;
                   selection_pile = NULL;
                 } else {
-                  ui_message(get_move_error());
+                  ui_message(get_move_error(state));
                 }
               } else {
                 selection = cursor_card;
                 selection_pile = cursor_pile;
               }
             } else if (cursor_pile->rule->type == RULE_STOCK) {
-              if (turn_from_stock(cursor_card, cursor_pile, piles)) {
+              if (turn_from_stock(state, cursor_card, cursor_pile)) {
                 move_made = 1;
-                clear();
               } else {
-                ui_message(get_move_error());
+                ui_message(get_move_error(state));
               }
             } else {
-              turn_card(cursor_card);
+              turn_card(state, cursor_card);
             }
           } else if (cursor_pile->rule->type == RULE_STOCK) {
-            if (redeal(cursor_pile, piles)) {
+            if (redeal(state, cursor_pile)) {
               move_made = 1;
-              clear();
             } else {
-              ui_message(get_move_error());
+              ui_message(get_move_error(state));
             }
           }
         }
@@ -965,11 +1040,10 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
             if (!cell_i) {
               Card *src = get_top(pile->stack);
               if (cursor_pile && NOT_BOTTOM(src)) {
-                if (legal_move_stack(cursor_pile, src, pile, piles)) {
+                if (legal_move_stack(state, cursor_pile, src, pile)) {
                   move_made = 1;
-                  clear();
                 } else {
-                  ui_message(get_move_error());
+                  ui_message(get_move_error(state));
                 }
               }
               break;
@@ -984,17 +1058,15 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
           if (pile->rule->type == RULE_STOCK) {
             Card *src = get_top(pile->stack);
             if (IS_BOTTOM(src)) {
-              if (redeal(pile, piles)) {
+              if (redeal(state, pile)) {
                 move_made = 1;
-                clear();
               } else {
-                ui_message(get_move_error());
+                ui_message(get_move_error(state));
               }
-            } else if (turn_from_stock(src, pile, piles)) {
+            } else if (turn_from_stock(state, src, pile)) {
               move_made = 1;
-              clear();
             } else {
-              ui_message(get_move_error());
+              ui_message(get_move_error(state));
             }
             break;
           }
@@ -1007,11 +1079,10 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
           if (pile->rule->type == RULE_WASTE) {
             Card *src = get_top(pile->stack);
             if (cursor_pile && NOT_BOTTOM(src)) {
-              if (legal_move_stack(cursor_pile, src, pile, piles)) {
+              if (legal_move_stack(state, cursor_pile, src, pile)) {
                 move_made = 1;
-                clear();
               } else {
-                ui_message(get_move_error());
+                ui_message(get_move_error(state));
               }
             }
             break;
@@ -1023,32 +1094,44 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
       case 10: /* enter */
       case 13: /* enter */
         if (selection && cursor_pile) {
-          if (legal_move_stack(cursor_pile, selection, selection_pile, piles)) {
+          if (legal_move_stack(state, cursor_pile, selection, selection_pile)) {
             move_made = 1;
-            clear();
             selection = NULL;
             selection_pile = NULL;
           } else {
-            ui_message(get_move_error());
+            ui_message(get_move_error(state));
           }
         }
         break;
       case 'a':
-        if (auto_move_to_foundation(piles)) {
+        if (auto_move_to_foundation(state)) {
           move_made = 1;
-          clear();
         }
         break;
+      case 't': {
+        Move hint;
+        switch (find_hint(game, state, hint_time, &hint)) {
+          case HINT_SOLUTION:
+            show_hint(piles, hint);
+            break;
+          case HINT_GUESS:
+            show_hint(piles, hint);
+            ui_message("Hint: best guess, no solution found");
+            break;
+          default:
+            ui_message("No moves available");
+            break;
+        }
+        break;
+      }
       case 'u':
       case 26: /* ^z */
-        undo_move();
-        clear();
+        undo_move(state);
         break;
       case 'U':
       case 25: /* ^y */
       case 18: /* ^r */
-        redo_move();
-        clear();
+        redo_move(state);
         break;
       case KEY_F(10):
         menu_selection[0] = main_menu;
@@ -1057,7 +1140,7 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
         selection = NULL;
         selection_pile = NULL;
         open_menu(getch(), main_menu, menu_selection);
-        clear();
+        redraw = 1;
         break;
       case 19: /* ^s */
         smart_cursor = !smart_cursor;
@@ -1077,36 +1160,39 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
         break;
       case 12: /* ^l */
         clear();
+        redraw = 1;
         break;
       case KEY_RESIZE:
         clear();
+        redraw = 1;
         break;
       case KEY_F(1):
       case '?':
         how_to_play();
-        clear();
+        redraw = 1;
         break;
       case KEY_F(13):
         about();
-        clear();
+        redraw = 1;
         break;
       case 'r':
         if (!game_started || ui_confirm("Redeal?")) {
           if (game_started) {
-            append_score(game->name, 0, game_score, time(NULL) - start_time, NULL);
+            append_score(game->name, 0, state->score, time(NULL) - start_time, NULL);
+            archive_replay(game, seed, state);
           }
           return 1;
         }
-        clear();
+        redraw = 1;
         break;
       case 'q':
         if (!game_started || ui_confirm("Quit?")) {
           if (game_started) {
-            append_score(game->name, 0, game_score, time(NULL) - start_time, NULL);
+            quit_game(game, state, seed, time(NULL) - start_time);
           }
           return 0;
         }
-        clear();
+        redraw = 1;
         break;
       case KEY_MOUSE:
         if (
@@ -1116,13 +1202,19 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
             getmouse(&mouse)
 #endif
             == OK) {
-          cur_y = mouse.y - theme->y_margin - off_y;
-          cur_x = (mouse.x - theme->x_margin) / (theme->width + theme->x_spacing);
-          max_cur_y = cur_y;
+          int x, y;
+          GridCell *cell = find_grid_cell(grid, theme, off_y, mouse.y, mouse.x, &x, &y);
+          if (cell) {
+            cursor_card = cell->card;
+            cursor_pile = cell->pile;
+            cur_x = x;
+            max_cur_y = cur_y = y;
+          }
           if (mouse.bstate & BUTTON3_CLICKED) {
-            mouse_action = 'm';
+            mouse_action = cell ? 'm' : 0;
           } else if (mouse.bstate & BUTTON1_CLICKED) {
-            mouse_action = ' ';
+            /* Clicks outside the board only go to the menubar */
+            mouse_action = cell ? ' ' : 0;
             menu_click.click = 1;
             menu_click.x = mouse.x;
             menu_click.y = mouse.y;
@@ -1145,7 +1237,8 @@ static int ui_loop(Game **current_game, Theme **current_theme, Pile *piles) {
   return 0;
 }
 
-void ui_main(Game *game, Theme *theme, int enable_color, unsigned int seed) {
+void ui_main(Game *game, Theme *theme, int enable_color, unsigned int seed, Replay *replay, int delay) {
+  Arena *arena;
 #ifdef USE_PDCURSES
   if (theme->utf8) {
     printf("Converting UTF8 theme\n");
@@ -1161,6 +1254,8 @@ void ui_main(Game *game, Theme *theme, int enable_color, unsigned int seed) {
     start_color();
     init_theme_colors(theme);
   }
+  cache_glyphs(theme);
+  grid = new_grid();
   raw();
   clear();
   curs_set(!alt_cursor);
@@ -1169,21 +1264,42 @@ void ui_main(Game *game, Theme *theme, int enable_color, unsigned int seed) {
 
   mousemask(BUTTON1_CLICKED | BUTTON3_CLICKED, NULL);
 
+  catch_terminate();
+  set_error_handler(show_error);
+
+  arena = new_arena(DEAL_ARENA_SIZE);
   while (1) {
-    Card *deck;
-    Pile *piles;
+    GameState *state = NULL;
+    uint32_t saved_seed;
+    int32_t duration = -1;
     int redeal;
-    srand(seed);
-
-    deck = new_deck(game->decks, game->deck_suits);
-    move_stack(deck, shuffle_stack(take_stack(deck->next)));
 
-    piles = deal_cards(game, deck);
+    if (!replay) {
+      state = resume_game(arena, game, &saved_seed, &duration);
+    }
+    if (state) {
+      seed = saved_seed;
+    } else {
+      Card *deck;
+      Rng rng;
+      rng_seed(&rng, seed);
+      deck = new_deck(arena, game->decks, game->deck_suits);
+      shuffle_stack(next_card(deck), &rng);
+      state = new_game_state(arena, game, deck);
+      duration = -1;
+    }
+    srand(seed);
+    state->undo_limit = undo_limit;
+    state->log_moves = 1;
     deals++;
 
-    redeal = ui_loop(&game, &theme, piles);
-    delete_piles(piles);
-    delete_stack(deck);
+    if (replay) {
+      ui_replay(game, theme, state, replay, delay);
+      replay = NULL;
+    }
+
+    redeal = ui_loop(&game, &theme, state, seed, duration);
+    clear_arena(arena);
 
     if (redeal) {
       seed = time(NULL) + deals;
@@ -1191,8 +1307,12 @@ void ui_main(Game *game, Theme *theme, int enable_color, unsigned int seed) {
       break;
     }
   }
+  delete_arena(arena);
+  delete_grid(grid);
+  free_glyphs();
   if (enable_color) {
     restore_colors(theme);
   }
   endwin();
+  set_error_handler(NULL);
 }
@@ -9,9 +9,12 @@
 
 #include "game.h"
 #include "theme.h"
+#include "replay.h"
 
 void format_time(char *out, int32_t time);
-void ui_main(Game *game, Theme *theme, int enable_color, unsigned int seed);
+/* Plays games until the user quits. If `replay` is set, its moves are played
+ * on the first deal with `delay` milliseconds between them. */
+void ui_main(Game *game, Theme *theme, int enable_color, unsigned int seed, Replay *replay, int delay);
 void ui_list_colors();
 
 #endif
@@ -14,12 +14,17 @@
 #include <sys/stat.h>
 #include <libgen.h>
 #include <errno.h>
+#include <time.h>
 #if defined(MSDOS) || defined(USE_DIRECT)
 #include <direct.h>
 #elif defined(_WIN32)
 #include <io.h>
 #endif
 
+#if defined(__unix__) || defined(__UNIX__) || defined(__linux__) || defined(__LINUX__)
+#define USE_CLOCK_GETTIME
+#endif
+
 int file_exists(const char *path) {
   FILE *f = fopen(path, "r");
   if (f) {
@@ -159,3 +164,14 @@ int mkdir_rec(const char *path) {
   free(buffer);
   return 1;
 }
+
+unsigned long get_milliseconds() {
+#ifdef USE_CLOCK_GETTIME
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#else
+  /* Processor time is wall time on DOS and Windows */
+  return (unsigned long)clock() * 1000 / CLOCKS_PER_SEC;
+#endif
+}
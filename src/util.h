@@ -24,5 +24,7 @@ char *combine_paths(const char *path1, const char *path2);
 char *find_data_file(const char *name, const char *arg0);
 char *find_system_config_file(const char *name);
 int mkdir_rec(const char *path);
+/* Milliseconds since some point in the past */
+unsigned long get_milliseconds();
 
 #endif
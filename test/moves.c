@@ -0,0 +1,218 @@
+/* csol
+ * Copyright (c) 2026 Niels Sonnich Poulsen (http://nielssp.dk)
+ * Licensed under the MIT license.
+ * See the LICENSE file or http://opensource.org/licenses/MIT for more information.
+ */
+
+/* Checks that generate_moves lists exactly the moves that a player can make.
+ * Random games are played for every game, or for the games given as
+ * arguments, and each generated stack move must start at a face-up card that
+ * the user interface shows and lets the player select. Perft counts are
+ * compared with a count made by trying every move the player could attempt,
+ * without generate_moves. */
+
+#include "game.h"
+#include "card.h"
+#include "rc.h"
+#include "rng.h"
+#include "arena.h"
+#include "render.h"
+#include "solver.h"
+#include "perft.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Number of deals per game */
+#define TEST_SEEDS 200
+
+/* Number of random moves played on each deal */
+#define TEST_MOVES 300
+
+/* Number of deals and depth of the perft comparison */
+#define PERFT_SEEDS 5
+#define PERFT_DEPTH 3
+
+/* Whether `card` is one of the cards of `pile` drawn by draw_piles */
+static int is_selectable(Pile *pile, Card *card) {
+  Card *shown;
+  for (shown = get_first_shown(pile); shown; shown = next_card(shown)) {
+    if (shown == card) {
+      return card->up;
+    }
+  }
+  return 0;
+}
+
+static unsigned long count_sequences(GameState *state, int depth);
+
+static unsigned long count_after(GameState *state, MoveType type, Pile *src, Pile *dest, int count,
+    int depth) {
+  unsigned long nodes;
+  Move move;
+  move.type = type;
+  move.src = src->index;
+  move.dest = dest->index;
+  move.count = count;
+  if (!play_move(state, move)) {
+    return 0;
+  }
+  nodes = count_sequences(state, depth - 1);
+  undo_move(state);
+  return nodes;
+}
+
+/* Like generate_moves, redeals of an empty waste pile are not counted */
+static int has_waste(GameState *state) {
+  Pile *pile;
+  for (pile = state->piles; pile; pile = pile->next) {
+    if (pile->rule->type == RULE_WASTE) {
+      return NOT_BOTTOM(get_top(pile->stack));
+    }
+  }
+  return 0;
+}
+
+/* Counts the same sequences as perft by trying every card that can be
+ * selected on every pile */
+static unsigned long count_sequences(GameState *state, int depth) {
+  Pile *src, *dest;
+  unsigned long nodes = 0;
+  if (depth <= 0) {
+    return 1;
+  }
+  for (src = state->piles; src; src = src->next) {
+    Card *top = get_top(src->stack);
+    if (src->rule->type == RULE_STOCK) {
+      if (NOT_BOTTOM(top)) {
+        nodes += count_after(state, MOVE_TURN_STOCK, src, src, 0, depth);
+      } else if (has_waste(state)) {
+        nodes += count_after(state, MOVE_REDEAL, src, src, 0, depth);
+      }
+    } else if (NOT_BOTTOM(top) && !top->up) {
+      nodes += count_after(state, MOVE_TURN_CARD, src, src, 1, depth);
+    } else {
+      Card *card;
+      int count = 1;
+      for (card = top; NOT_BOTTOM(card) && is_selectable(src, card); card = prev_card(card), count++) {
+        for (dest = state->piles; dest; dest = dest->next) {
+          if (dest != src) {
+            nodes += count_after(state, MOVE_STACK, src, dest, count, depth);
+          }
+        }
+      }
+    }
+  }
+  return nodes;
+}
+
+static int check_perft(Game *game, unsigned int seed, MoveList **lists, Arena *arena) {
+  Card *deck;
+  GameState *state;
+  Rng rng;
+  unsigned long expected, nodes;
+  long errors = 0;
+  rng_seed(&rng, seed);
+  deck = new_deck(arena, game->decks, game->deck_suits);
+  shuffle_stack(next_card(deck), &rng);
+  state = new_game_state(arena, game, deck);
+  expected = count_sequences(state, PERFT_DEPTH);
+  nodes = perft(state, lists, PERFT_DEPTH, &errors);
+  clear_arena(arena);
+  if (nodes != expected || errors) {
+    printf("%s #%u: perft %lu, expected %lu, %ld errors\n", game->name, seed, nodes, expected, errors);
+    return 1;
+  }
+  return 0;
+}
+
+static int check_moves(Game *game, unsigned int seed, MoveList *list, Arena *arena) {
+  Card *deck;
+  GameState *state;
+  Rng rng;
+  int errors = 0, i, j;
+  rng_seed(&rng, seed);
+  deck = new_deck(arena, game->decks, game->deck_suits);
+  shuffle_stack(next_card(deck), &rng);
+  state = new_game_state(arena, game, deck);
+  for (i = 0; i < TEST_MOVES && !errors; i++) {
+    int count = generate_moves(state->piles, list);
+    if (!count) {
+      break;
+    }
+    for (j = 0; j < count; j++) {
+      Move move = list->moves[j];
+      Pile *src = get_pile(state->piles, move.src);
+      Stack *stack = src->stack->stack;
+      if (move.type == MOVE_STACK && !is_selectable(src, stack->cards[stack->size - move.count])) {
+        printf("%s #%u, move %d: ", game->name, seed, i + 1);
+        print_move(stdout, move, state->piles);
+        printf(" starts at a card that can't be selected\n");
+        errors++;
+      }
+    }
+    if (!play_move(state, list->moves[rng_range(&rng, count)])) {
+      printf("%s #%u, move %d: generated move rejected\n", game->name, seed, i + 1);
+      errors++;
+    }
+  }
+  clear_arena(arena);
+  return errors;
+}
+
+static int check_game(Game *game) {
+  Arena *arena = new_arena(DEAL_ARENA_SIZE);
+  MoveList *lists[PERFT_DEPTH];
+  unsigned int seed;
+  int errors = 0, i;
+  for (i = 0; i < PERFT_DEPTH; i++) {
+    lists[i] = new_move_list();
+  }
+  for (seed = 1; seed <= TEST_SEEDS; seed++) {
+    errors += check_moves(game, seed, lists[0], arena);
+  }
+  for (seed = 1; seed <= PERFT_SEEDS; seed++) {
+    errors += check_perft(game, seed, lists, arena);
+  }
+  for (i = 0; i < PERFT_DEPTH; i++) {
+    delete_move_list(lists[i]);
+  }
+  delete_arena(arena);
+  printf("%s: %s\n", game->name, errors ? "failed" : "ok");
+  return errors;
+}
+
+int main(int argc, char *argv[]) {
+  char *rc_file = "csolrc";
+  int i, first_game = argc, errors = 0;
+  for (i = 1; i < argc && first_game == argc; i++) {
+    if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      rc_file = argv[++i];
+    } else if (argv[i][0] == '-') {
+      printf("usage: %s [-c file] [game...]\n", argv[0]);
+      return 1;
+    } else {
+      first_game = i;
+    }
+  }
+  if (!execute_file(rc_file)) {
+    return 1;
+  }
+  if (first_game < argc) {
+    for (i = first_game; i < argc; i++) {
+      Game *game = get_game(argv[i]);
+      if (!game) {
+        printf("game not found: '%s'\n", argv[i]);
+        return 1;
+      }
+      errors += check_game(game);
+    }
+  } else {
+    GameList *list;
+    load_game_dirs();
+    for (list = list_games(); list; list = list->next) {
+      errors += check_game(list->game);
+    }
+  }
+  return errors != 0;
+}